@@ -0,0 +1,97 @@
+﻿// #include "config-diff.h"
+#include "config-diff.h"
+
+// #include <string_view>
+#include <string_view>
+// #include <unordered_map>
+#include <unordered_map>
+
+namespace akrbt {
+namespace config {
+std::vector<Change> Diff(const Value& old_value, const Value& new_value) {
+  struct Frame {
+    const Value* old_value;
+    const Value* new_value;
+    std::string path;
+  };
+
+  std::vector<Change> changes;
+  std::vector<Frame> frames;
+  frames.push_back(Frame{&old_value, &new_value, std::string()});
+
+  while (!frames.empty()) {
+    Frame frame = std::move(frames.back());
+    frames.pop_back();
+
+    const Value& lhs = *frame.old_value;
+    const Value& rhs = *frame.new_value;
+
+    if (lhs.is_null() && rhs.is_null()) {
+      continue;
+    } else if (lhs.is_null()) {
+      changes.push_back(Change{Change::Type::ADDED, std::move(frame.path)});
+      continue;
+    } else if (rhs.is_null()) {
+      changes.push_back(Change{Change::Type::REMOVED, std::move(frame.path)});
+      continue;
+    }
+
+    if (lhs.is_same(rhs) || lhs.Hash() == rhs.Hash()) {
+      continue;
+    }
+
+    if (lhs.is_object() && rhs.is_object()) {
+      const Object& lhs_object = lhs.as_object();
+      const Object& rhs_object = rhs.as_object();
+
+      std::unordered_map<std::string_view, const Value*> rhs_fields;
+      rhs_fields.reserve(rhs_object.size());
+      for (auto& field : rhs_object) {
+        rhs_fields.emplace(field.first, &field.second);
+      }
+
+      for (auto& field : lhs_object) {
+        auto iter = rhs_fields.find(field.first);
+
+        if (iter == rhs_fields.end()) {
+          if (!field.second.is_null()) {
+            changes.push_back(Change{Change::Type::REMOVED, Path::Join(frame.path, field.first)});
+          }
+        } else {
+          frames.push_back(Frame{&field.second, iter->second, Path::Join(frame.path, field.first)});
+          rhs_fields.erase(iter);
+        }
+      }
+
+      // Keep additions in the order of the new object.
+      for (auto& field : rhs_object) {
+        if (!field.second.is_null() && rhs_fields.count(field.first) != 0) {
+          changes.push_back(Change{Change::Type::ADDED, Path::Join(frame.path, field.first)});
+        }
+      }
+    } else if (lhs.is_array() && rhs.is_array()) {
+      const Array& lhs_array = lhs.as_array();
+      const Array& rhs_array = rhs.as_array();
+
+      for (Array::size_type i = 0; i < std::max(lhs_array.size(), rhs_array.size()); ++i) {
+        std::string path = frame.path;
+        Path::Append(path, i);
+
+        // Elements are positional, so even a null one changes the size.
+        if (i >= rhs_array.size()) {
+          changes.push_back(Change{Change::Type::REMOVED, path});
+        } else if (i >= lhs_array.size()) {
+          changes.push_back(Change{Change::Type::ADDED, path});
+        } else {
+          frames.push_back(Frame{&lhs_array.at(i), &rhs_array.at(i), path});
+        }
+      }
+    } else {
+      changes.push_back(Change{Change::Type::MODIFIED, std::move(frame.path)});
+    }
+  }
+
+  return changes;
+}
+}  // namespace config
+}  // namespace akrbt
\ No newline at end of file
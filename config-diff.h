@@ -0,0 +1,34 @@
+﻿#pragma once
+
+// #include <string>
+#include <string>
+// #include <vector>
+#include <vector>
+
+// #include "config.h"
+#include "config.h"
+
+namespace akrbt {
+namespace config {
+struct Change {
+  enum class Type {
+    ADDED,
+    REMOVED,
+    MODIFIED,
+  };
+
+  Type type;
+  // See Path.
+  std::string path;
+};
+
+// Lists what changed between two trees; the list is empty exactly when the
+// trees compare equal. Subtrees with equal Value::Hash() are taken as
+// unchanged without being visited. Hashes stay cached until their own tree
+// changes, so after a reload only the new tree is hashed in full and the
+// rest of the walk follows the paths to real changes. Null fields count as
+// absent, while array elements, null or not, are compared by position; a
+// field whose type changes, or a leaf whose value changes, is MODIFIED.
+std::vector<Change> Diff(const Value& old_value, const Value& new_value);
+}  // namespace config
+}  // namespace akrbt
\ No newline at end of file
@@ -0,0 +1,612 @@
+﻿#pragma once
+
+#if !defined(__cpp_consteval) || __cpp_consteval < 201811L
+#error "config-embedded.h requires C++20 (consteval)"
+#endif
+
+// #include <array>
+#include <array>
+// #include <cstdint>
+#include <cstdint>
+// #include <string_view>
+#include <string_view>
+
+// #include "config.h"
+#include "config.h"
+
+// Parses a config literal at compile time; a malformed literal is a compile
+// error pointing at InvalidEmbeddedConfig(). So is a double that could come
+// out different from Value::Load(): its significant digits must fit in 53
+// bits (any 15 digits do) and it must not need a power of ten beyond 1e22.
+// A named block opened again and a repeated key are merged as by Load().
+//
+//   static constexpr auto DEFAULTS = AKRBT_EMBED_CONFIG(R"(
+//     <server>
+//       <key="port" type="Number" value="8080">
+//     </server>
+//   )");
+//   static_assert(DEFAULTS.get_integer("server.port") == 8080);
+#define AKRBT_EMBED_CONFIG(text) \
+  ::akrbt::config::embedded::Parse<::akrbt::config::embedded::CountEntries<::akrbt::config::embedded::CountTags(text)>(text)>(text)
+
+namespace akrbt {
+namespace config {
+namespace embedded {
+// Not constexpr on purpose: reaching it during constant evaluation is what
+// turns a parse error into a compile error.
+inline void InvalidEmbeddedConfig(const char* message) { throw Exception(message); }
+
+struct Entry {
+  enum class NumberType {
+    SIGNED,
+    UNSIGNED,
+    DOUBLE,
+  };
+
+  // Empty for the root and for array elements.
+  std::string_view key;
+  Value::Type type = Value::Type::NULL_VALUE;
+  int32_t parent = -1;
+  int32_t first_child = -1;
+  int32_t last_child = -1;
+  int32_t next_sibling = -1;
+
+  std::string_view string_value;
+  NumberType number_type = NumberType::SIGNED;
+  int64_t int64_value = 0;
+  uint64_t uint64_value = 0;
+  double double_value = 0.0;
+  bool boolean_value = false;
+};
+
+// Entries are stored in the order their keys first appear, so every parent
+// precedes its children. Entry 0 is the root. Children dropped by a repeated
+// key stay in place but are no longer linked.
+template <size_t N>
+class EmbeddedConfig {
+ public:
+  constexpr size_t size() const { return N; }
+  constexpr const Entry& entry(size_t index) const { return entries_[index]; }
+
+  constexpr bool contains(std::string_view path) const { return Find(path) != nullptr; }
+
+  constexpr Value::Type type(std::string_view path) const {
+    const Entry* entry = Find(path);
+    return entry == nullptr ? Value::Type::NULL_VALUE : entry->type;
+  }
+
+  constexpr std::string_view get_string(std::string_view path, std::string_view default_value = std::string_view()) const {
+    const Entry* entry = Find(path);
+    return entry != nullptr && entry->type == Value::Type::STRING ? entry->string_value : default_value;
+  }
+
+  constexpr int32_t get_integer(std::string_view path, int32_t default_value = 0) const {
+    return static_cast<int32_t>(get_int64(path, default_value));
+  }
+
+  constexpr int64_t get_int64(std::string_view path, int64_t default_value = 0) const {
+    const Entry* entry = Find(path);
+    if (entry == nullptr || entry->type != Value::Type::NUMBER) {
+      return default_value;
+    }
+
+    switch (entry->number_type) {
+      case Entry::NumberType::SIGNED:
+        return entry->int64_value;
+
+      case Entry::NumberType::UNSIGNED:
+        return static_cast<int64_t>(entry->uint64_value);
+
+      case Entry::NumberType::DOUBLE:
+        return static_cast<int64_t>(entry->double_value);
+    }
+
+    return default_value;
+  }
+
+  constexpr double get_double(std::string_view path, double default_value = 0.0) const {
+    const Entry* entry = Find(path);
+    if (entry == nullptr || entry->type != Value::Type::NUMBER) {
+      return default_value;
+    }
+
+    switch (entry->number_type) {
+      case Entry::NumberType::SIGNED:
+        return static_cast<double>(entry->int64_value);
+
+      case Entry::NumberType::UNSIGNED:
+        return static_cast<double>(entry->uint64_value);
+
+      case Entry::NumberType::DOUBLE:
+        return entry->double_value;
+    }
+
+    return default_value;
+  }
+
+  constexpr bool get_boolean(std::string_view path, bool default_value = false) const {
+    const Entry* entry = Find(path);
+    return entry != nullptr && entry->type == Value::Type::BOOLEAN ? entry->boolean_value : default_value;
+  }
+
+  // See Path.
+  constexpr const Entry* Find(std::string_view path) const {
+    int32_t current = 0;
+    size_t position = 0;
+    std::string_view segment;
+
+    while (Path::Next(path, position, segment)) {
+      const Entry& parent = entries_[current];
+      int32_t child = parent.first_child;
+
+      if (parent.type == Value::Type::OBJECT) {
+        while (child != -1 && entries_[child].key != segment) {
+          child = entries_[child].next_sibling;
+        }
+      } else if (parent.type == Value::Type::ARRAY) {
+        Array::size_type index = 0;
+        if (!Path::ParseIndex(segment, index)) {
+          return nullptr;
+        }
+
+        for (; child != -1 && index > 0; --index) {
+          child = entries_[child].next_sibling;
+        }
+      } else {
+        return nullptr;
+      }
+
+      if (child == -1) {
+        return nullptr;
+      }
+
+      current = child;
+    }
+
+    return entries_[current].type == Value::Type::NULL_VALUE ? nullptr : &entries_[current];
+  }
+
+  Value ToValue() const {
+    Value root;
+    // Next child to build of every open container. Following the links
+    // builds each subtree completely before its next sibling is appended, so
+    // the pointers kept for open containers stay valid.
+    std::vector<std::pair<int32_t, Value*>> open;
+    int32_t index = 0;
+    Value* target = &root;
+
+    while (true) {
+      const Entry& entry = entries_[index];
+
+      switch (entry.type) {
+        case Value::Type::NULL_VALUE:
+          *target = Value::null();
+          break;
+
+        case Value::Type::STRING:
+          *target = Value::string(std::string(entry.string_value));
+          break;
+
+        case Value::Type::NUMBER:
+          if (entry.number_type == Entry::NumberType::SIGNED) {
+            *target = Value::number(entry.int64_value);
+          } else if (entry.number_type == Entry::NumberType::UNSIGNED) {
+            *target = Value::number(entry.uint64_value);
+          } else {
+            *target = Value::number(entry.double_value);
+          }
+          break;
+
+        case Value::Type::BOOLEAN:
+          *target = Value::boolean(entry.boolean_value);
+          break;
+
+        case Value::Type::ARRAY:
+          *target = Value::array();
+          break;
+
+        case Value::Type::OBJECT:
+          *target = Value::object();
+          break;
+      }
+
+      if (entry.first_child != -1) {
+        open.push_back(std::pair<int32_t, Value*>(entry.first_child, target));
+      }
+
+      while (!open.empty() && open.back().first == -1) {
+        open.pop_back();
+      }
+
+      if (open.empty()) {
+        break;
+      }
+
+      Value& parent = *open.back().second;
+      index = open.back().first;
+      open.back().first = entries_[index].next_sibling;
+      target = parent.is_array() ? &parent[parent.as_array().size()] : &parent[std::string(entries_[index].key)];
+    }
+
+    return root;
+  }
+
+ private:
+  template <size_t M>
+  friend consteval EmbeddedConfig<M> Parse(std::string_view text);
+
+  std::array<Entry, N> entries_{};
+};
+
+namespace details {
+constexpr bool IsSpace(char c) { return c == ' ' || c == '\t' || c == '\r' || c == '\n'; }
+
+constexpr double PowerOfTen(int exponent) {
+  double result = 1.0;
+  for (int i = 0; i < (exponent < 0 ? -exponent : exponent); ++i) {
+    result *= 10.0;
+  }
+
+  return exponent < 0 ? 1.0 / result : result;
+}
+
+constexpr void ParseNumber(std::string_view text, Entry& entry) {
+  size_t position = 0;
+  bool negative = false;
+
+  if (position < text.size() && text[position] == '-') {
+    negative = true;
+    position++;
+  }
+
+  uint64_t mantissa = 0;
+  int exponent = 0;
+  bool is_double = false;
+  bool overflow = false;
+  // A nonzero digit did not fit in the mantissa.
+  bool truncated = false;
+  size_t digits = 0;
+
+  for (; position < text.size(); ++position) {
+    char c = text[position];
+
+    if (c >= '0' && c <= '9') {
+      digits++;
+
+      if (mantissa > (UINT64_MAX - static_cast<uint64_t>(c - '0')) / 10) {
+        // Keep the leading digits; only doubles can go on from here.
+        overflow = true;
+        truncated = truncated || c != '0';
+        exponent += is_double ? 0 : 1;
+      } else {
+        mantissa = mantissa * 10 + static_cast<uint64_t>(c - '0');
+        exponent -= is_double ? 1 : 0;
+      }
+    } else if (c == '.' && !is_double) {
+      is_double = true;
+    } else {
+      break;
+    }
+  }
+
+  if (digits == 0) {
+    InvalidEmbeddedConfig("invalid number");
+  }
+
+  if (position < text.size() && (text[position] == 'e' || text[position] == 'E')) {
+    is_double = true;
+    position++;
+
+    bool negative_exponent = false;
+    if (position < text.size() && (text[position] == '+' || text[position] == '-')) {
+      negative_exponent = text[position] == '-';
+      position++;
+    }
+
+    int value = 0;
+    size_t exponent_digits = 0;
+    for (; position < text.size() && text[position] >= '0' && text[position] <= '9'; ++position, ++exponent_digits) {
+      value = value * 10 + (text[position] - '0');
+    }
+
+    if (exponent_digits == 0) {
+      InvalidEmbeddedConfig("invalid number");
+    }
+
+    exponent += negative_exponent ? -value : value;
+  }
+
+  if (position != text.size()) {
+    InvalidEmbeddedConfig("invalid number");
+  }
+
+  if (is_double) {
+    // One multiplication or division of exact operands rounds correctly, so
+    // the result matches a runtime parse, as long as the mantissa fits in 53
+    // bits and the power of ten is exactly representable (at most 1e22).
+    // Anything else would need arbitrary precision and is rejected.
+    const uint64_t MAX_EXACT = uint64_t(1) << 53;
+
+    while (mantissa > MAX_EXACT && mantissa % 10 == 0) {
+      mantissa /= 10;
+      exponent++;
+    }
+
+    while (mantissa != 0 && exponent > 22 && mantissa * 10 <= MAX_EXACT) {
+      mantissa *= 10;
+      exponent--;
+    }
+
+    if (mantissa != 0 && (truncated || mantissa > MAX_EXACT || exponent > 22 || exponent < -22)) {
+      InvalidEmbeddedConfig("number cannot be decoded exactly at compile time");
+    }
+
+    double value = static_cast<double>(mantissa);
+    if (mantissa != 0) {
+      value = exponent < 0 ? value / PowerOfTen(-exponent) : value * PowerOfTen(exponent);
+    }
+
+    entry.number_type = Entry::NumberType::DOUBLE;
+    entry.double_value = negative ? -value : value;
+  } else if (overflow) {
+    InvalidEmbeddedConfig("number out of range");
+  } else if (negative) {
+    if (mantissa > static_cast<uint64_t>(INT64_MAX) + 1) {
+      InvalidEmbeddedConfig("number out of range");
+    }
+
+    entry.number_type = Entry::NumberType::SIGNED;
+    entry.int64_value = mantissa == static_cast<uint64_t>(INT64_MAX) + 1 ? INT64_MIN : -static_cast<int64_t>(mantissa);
+  } else if (mantissa > static_cast<uint64_t>(INT64_MAX)) {
+    entry.number_type = Entry::NumberType::UNSIGNED;
+    entry.uint64_value = mantissa;
+  } else {
+    entry.number_type = Entry::NumberType::SIGNED;
+    entry.int64_value = static_cast<int64_t>(mantissa);
+  }
+}
+
+// Walks the tags of text the same way Parser does and builds what
+// ValueBuilder would: a key given again in an object reuses its entry, so a
+// reopened named block keeps its fields and a repeated field is overwritten
+// in place. With entries == nullptr it only counts the tags, an upper bound
+// for the entries.
+template <size_t N>
+constexpr size_t Scan(std::string_view text, std::array<Entry, N>* entries) {
+  size_t count = 1;
+  int32_t current = 0;
+  // Whether the type of the current block is known. A reopened block
+  // decides again with its first new child.
+  bool decided = false;
+
+  auto add = [&](std::string_view key, int32_t parent) -> int32_t {
+    if (entries == nullptr) {
+      return static_cast<int32_t>(count++);
+    }
+
+    Entry& owner = (*entries)[parent];
+
+    if (owner.type == Value::Type::OBJECT) {
+      for (int32_t sibling = owner.first_child; sibling != -1; sibling = (*entries)[sibling].next_sibling) {
+        if ((*entries)[sibling].key == key) {
+          return sibling;
+        }
+      }
+    }
+
+    int32_t index = static_cast<int32_t>(count++);
+    Entry& entry = (*entries)[index];
+    entry.key = key;
+    entry.parent = parent;
+
+    if (owner.first_child == -1) {
+      owner.first_child = index;
+    } else {
+      (*entries)[owner.last_child].next_sibling = index;
+    }
+
+    owner.last_child = index;
+    return index;
+  };
+
+  // Drops the value and the fields of an entry, keeping its place. Dropped
+  // children stay behind, unlinked.
+  auto reset = [&](int32_t index) {
+    Entry& entry = (*entries)[index];
+    Entry fresh;
+    fresh.key = entry.key;
+    fresh.parent = entry.parent;
+    fresh.next_sibling = entry.next_sibling;
+    entry = fresh;
+  };
+
+  // The type of a block is known once its first child is seen. A block
+  // reopened with another type starts over, like in ValueBuilder.
+  auto decide = [&](Value::Type type) {
+    if (entries == nullptr) {
+      return;
+    }
+
+    Entry& entry = (*entries)[current];
+    if (!decided) {
+      if (entry.type != type) {
+        reset(current);
+        entry.type = type;
+      }
+
+      decided = true;
+    } else if (entry.type != type) {
+      InvalidEmbeddedConfig(type == Value::Type::OBJECT ? "keyed field inside an array" : "field without key inside an object");
+    }
+  };
+
+  // Named blocks are told apart from #Array/#Object elements by their key.
+  // A block closed before any child is an empty (null) field, even if it
+  // had fields before.
+  auto close = [&](bool named, std::string_view name) {
+    if (entries == nullptr) {
+      return;
+    }
+
+    const Entry& entry = (*entries)[current];
+    if (current == 0 || named == entry.key.empty() || (named && entry.key != name)) {
+      InvalidEmbeddedConfig("unexpected closing tag");
+    }
+
+    if (!decided) {
+      reset(current);
+    }
+
+    current = entry.parent;
+    decided = true;
+  };
+
+  for (size_t position = 0; position < text.size();) {
+    size_t open = text.find('<', position);
+    if (open == std::string_view::npos) {
+      break;
+    }
+
+    size_t end = open + 1;
+    for (bool in_quotes = false; end < text.size() && (in_quotes || text[end] != '>'); ++end) {
+      in_quotes = text[end] == '"' ? !in_quotes : in_quotes;
+    }
+
+    if (end == text.size()) {
+      InvalidEmbeddedConfig("unexpected end of input");
+    }
+
+    std::string_view tag = text.substr(open + 1, end - open - 1);
+    position = end + 1;
+
+    if (tag == "#Array" || tag == "#Object") {
+      decide(Value::Type::ARRAY);
+      int32_t index = add(std::string_view(), current);
+
+      if (entries != nullptr) {
+        (*entries)[index].type = tag == "#Array" ? Value::Type::ARRAY : Value::Type::OBJECT;
+        current = index;
+        decided = true;
+      }
+    } else if (tag == "Array#" || tag == "Object#") {
+      if (entries != nullptr && (*entries)[current].type != (tag == "Array#" ? Value::Type::ARRAY : Value::Type::OBJECT)) {
+        InvalidEmbeddedConfig("unexpected closing tag");
+      }
+
+      close(false, std::string_view());
+    } else if (!tag.empty() && tag[0] == '/') {
+      close(true, tag.substr(1));
+    } else if (tag.find('=') != std::string_view::npos) {
+      std::string_view key, type, value;
+      bool has_key = false, has_type = false, has_value = false;
+
+      for (size_t at = 0;;) {
+        while (at < tag.size() && IsSpace(tag[at])) {
+          at++;
+        }
+
+        if (at == tag.size()) {
+          break;
+        }
+
+        size_t equals = tag.find('=', at);
+        if (equals == std::string_view::npos || equals + 1 >= tag.size() || tag[equals + 1] != '"') {
+          InvalidEmbeddedConfig("invalid attribute");
+        }
+
+        size_t quote = tag.find('"', equals + 2);
+        if (quote == std::string_view::npos) {
+          InvalidEmbeddedConfig("invalid attribute");
+        }
+
+        std::string_view name = tag.substr(at, equals - at);
+        std::string_view content = tag.substr(equals + 2, quote - equals - 2);
+
+        if (name == "key") {
+          key = content;
+          has_key = true;
+        } else if (name == "type") {
+          type = content;
+          has_type = true;
+        } else if (name == "value") {
+          value = content;
+          has_value = true;
+        } else {
+          InvalidEmbeddedConfig("unknown attribute");
+        }
+
+        at = quote + 1;
+      }
+
+      if (!has_type || !has_value) {
+        InvalidEmbeddedConfig("missing type or value");
+      }
+
+      decide(has_key ? Value::Type::OBJECT : Value::Type::ARRAY);
+      int32_t index = add(key, current);
+
+      if (entries != nullptr) {
+        reset(index);
+        Entry& entry = (*entries)[index];
+
+        if (type == "String") {
+          entry.type = Value::Type::STRING;
+          entry.string_value = value;
+        } else if (type == "Number") {
+          entry.type = Value::Type::NUMBER;
+          ParseNumber(value, entry);
+        } else if (type == "Boolean") {
+          entry.type = Value::Type::BOOLEAN;
+          entry.boolean_value = value != "false";
+        } else {
+          InvalidEmbeddedConfig("unknown type");
+        }
+      }
+    } else {
+      if (tag.empty() || tag[0] == '#') {
+        InvalidEmbeddedConfig("invalid tag");
+      }
+
+      for (char c : tag) {
+        if (IsSpace(c) || c == '/' || c == '#') {
+          InvalidEmbeddedConfig("invalid tag");
+        }
+      }
+
+      decide(Value::Type::OBJECT);
+      int32_t index = add(tag, current);
+
+      if (entries != nullptr) {
+        current = index;
+        decided = false;
+      }
+    }
+  }
+
+  if (entries != nullptr && current != 0) {
+    InvalidEmbeddedConfig("unclosed tag");
+  }
+
+  return count;
+}
+}  // namespace details
+
+consteval size_t CountTags(std::string_view text) { return details::Scan<0>(text, nullptr); }
+
+// Entries left once repeated keys share theirs; M is CountTags(text).
+template <size_t M>
+consteval size_t CountEntries(std::string_view text) {
+  std::array<Entry, M> entries{};
+  return details::Scan(text, &entries);
+}
+
+template <size_t N>
+consteval EmbeddedConfig<N> Parse(std::string_view text) {
+  EmbeddedConfig<N> config;
+  details::Scan(text, &config.entries_);
+
+  return config;
+}
+}  // namespace embedded
+}  // namespace config
+}  // namespace akrbt
\ No newline at end of file
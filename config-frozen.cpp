@@ -0,0 +1,268 @@
+﻿// #include "config-frozen.h"
+#include "config-frozen.h"
+
+// #include <algorithm>
+#include <algorithm>
+// #include <limits>
+#include <limits>
+// #include <unordered_set>
+#include <unordered_set>
+
+namespace akrbt {
+namespace config {
+namespace {
+uint32_t ToOffset(size_t value) {
+  if (value > std::numeric_limits<uint32_t>::max()) {
+    throw Exception("config too large to freeze");
+  }
+
+  return static_cast<uint32_t>(value);
+}
+}  // namespace
+
+FrozenConfig::FrozenConfig() : seed_(0), displacements_(), leaves_(), keys_(), strings_() {}
+
+FrozenConfig FrozenConfig::Compile(const Value& value) {
+  FrozenConfig frozen;
+  std::vector<Leaf> leaves;
+
+  // Collect the leaves; a repeated key keeps its first value, as Object::at() does.
+  std::unordered_set<std::string> paths;
+  std::string path;
+
+  Walker walker(value);
+  while (walker.Next()) {
+    if (walker.is_container() || walker.value().is_null()) {
+      continue;
+    }
+
+    path.clear();
+    walker.AppendPath(path);
+
+    if (!paths.insert(path).second) {
+      continue;
+    }
+
+    Leaf leaf = Leaf();
+    leaf.key_offset = ToOffset(frozen.keys_.size());
+    leaf.key_size = ToOffset(path.size());
+    leaf.type = walker.value().type();
+    frozen.keys_ += path;
+
+    if (const std::string* string_value = walker.value().get_if<std::string>()) {
+      leaf.string.offset = ToOffset(frozen.strings_.size());
+      leaf.string.size = ToOffset(string_value->size());
+      frozen.strings_ += *string_value;
+    } else if (const Number* number = walker.value().get_if<Number>()) {
+      leaf.number_type = number->type_;
+
+      switch (number->type_) {
+        case Number::Type::SIGNED:
+          leaf.int64_value = number->int64_value_;
+          break;
+
+        case Number::Type::UNSIGNED:
+          leaf.uint64_value = number->uint64_value_;
+          break;
+
+        case Number::Type::DOUBLE:
+          leaf.double_value = number->double_value_;
+          break;
+      }
+    } else if (const bool* boolean = walker.value().get_if<bool>()) {
+      leaf.boolean_value = *boolean;
+    }
+
+    leaves.push_back(leaf);
+  }
+
+  if (leaves.empty()) {
+    return frozen;
+  }
+
+  // A bucket whose seeds all collide starts the whole placement over with
+  // another first level seed; the seeds stay clear of the bucket seeds.
+  for (uint64_t attempt = 0; attempt < MAX_ATTEMPTS; ++attempt) {
+    if (frozen.Place(leaves, attempt == 0 ? 0 : MAX_SEED + attempt)) {
+      return frozen;
+    }
+  }
+
+  throw Exception("cannot build a perfect hash for the config");
+}
+
+// Hash and displace: about four keys per bucket, largest buckets placed
+// first, each with the first seed up to MAX_SEED that sends all of its keys
+// to free slots. Single-key buckets take any free slot directly.
+bool FrozenConfig::Place(const std::vector<Leaf>& leaves, uint64_t seed) {
+  size_t count = leaves.size();
+  size_t bucket_count = std::max<size_t>(count / 4, 1);
+  std::vector<std::vector<size_t>> buckets(bucket_count);
+
+  for (size_t i = 0; i < count; ++i) {
+    std::string_view key(keys_.data() + leaves[i].key_offset, leaves[i].key_size);
+    buckets[Hash(seed, key) % bucket_count].push_back(i);
+  }
+
+  std::vector<size_t> order(bucket_count);
+  for (size_t i = 0; i < bucket_count; ++i) {
+    order[i] = i;
+  }
+
+  std::sort(order.begin(), order.end(), [&buckets](size_t lhs, size_t rhs) -> bool { return buckets[lhs].size() > buckets[rhs].size(); });
+
+  seed_ = seed;
+  displacements_.assign(bucket_count, 0);
+  leaves_.resize(count);
+
+  std::vector<bool> used(count, false);
+  std::vector<size_t> slots;
+  size_t free_slot = 0;
+
+  for (size_t bucket : order) {
+    const std::vector<size_t>& members = buckets[bucket];
+
+    if (members.empty()) {
+      break;
+    }
+
+    if (members.size() == 1) {
+      while (used[free_slot]) {
+        free_slot++;
+      }
+
+      used[free_slot] = true;
+      leaves_[free_slot] = leaves[members[0]];
+      displacements_[bucket] = -static_cast<int64_t>(free_slot) - 1;
+      continue;
+    }
+
+    uint64_t bucket_seed = 1;
+    for (; bucket_seed <= MAX_SEED; ++bucket_seed) {
+      slots.clear();
+
+      for (size_t member : members) {
+        std::string_view key(keys_.data() + leaves[member].key_offset, leaves[member].key_size);
+        size_t slot = Hash(bucket_seed, key) % count;
+
+        if (used[slot] || std::find(slots.begin(), slots.end(), slot) != slots.end()) {
+          break;
+        }
+
+        slots.push_back(slot);
+      }
+
+      if (slots.size() == members.size()) {
+        for (size_t i = 0; i < members.size(); ++i) {
+          used[slots[i]] = true;
+          leaves_[slots[i]] = leaves[members[i]];
+        }
+
+        displacements_[bucket] = static_cast<int64_t>(bucket_seed);
+        break;
+      }
+    }
+
+    if (bucket_seed > MAX_SEED) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+Value::Type FrozenConfig::type(std::string_view path) const {
+  const Leaf* leaf = Find(path);
+
+  return leaf == nullptr ? Value::Type::NULL_VALUE : leaf->type;
+}
+
+std::string_view FrozenConfig::get_string(std::string_view path, std::string_view default_value) const {
+  const Leaf* leaf = Find(path);
+  if (leaf == nullptr || leaf->type != Value::Type::STRING) {
+    return default_value;
+  }
+
+  return std::string_view(strings_.data() + leaf->string.offset, leaf->string.size);
+}
+
+int32_t FrozenConfig::get_integer(std::string_view path, int32_t default_value) const {
+  const Leaf* leaf = Find(path);
+  if (leaf == nullptr || leaf->type != Value::Type::NUMBER) {
+    return default_value;
+  }
+
+  return ToNumber(*leaf).to_int32();
+}
+
+int64_t FrozenConfig::get_int64(std::string_view path, int64_t default_value) const {
+  const Leaf* leaf = Find(path);
+  if (leaf == nullptr || leaf->type != Value::Type::NUMBER) {
+    return default_value;
+  }
+
+  return ToNumber(*leaf).to_int64();
+}
+
+double FrozenConfig::get_double(std::string_view path, double default_value) const {
+  const Leaf* leaf = Find(path);
+  if (leaf == nullptr || leaf->type != Value::Type::NUMBER) {
+    return default_value;
+  }
+
+  return ToNumber(*leaf).to_double();
+}
+
+bool FrozenConfig::get_boolean(std::string_view path, bool default_value) const {
+  const Leaf* leaf = Find(path);
+  if (leaf == nullptr || leaf->type != Value::Type::BOOLEAN) {
+    return default_value;
+  }
+
+  return leaf->boolean_value;
+}
+
+// FNV-1a, with the seed mixed into the offset basis.
+uint64_t FrozenConfig::Hash(uint64_t seed, std::string_view key) {
+  uint64_t hash = 0xcbf29ce484222325ULL ^ (seed * 0x9e3779b97f4a7c15ULL);
+
+  for (char c : key) {
+    hash ^= static_cast<unsigned char>(c);
+    hash *= 0x100000001b3ULL;
+  }
+
+  return hash ^ (hash >> 32);
+}
+
+Number FrozenConfig::ToNumber(const Leaf& leaf) {
+  switch (leaf.number_type) {
+    case Number::Type::SIGNED:
+      return Number(leaf.int64_value);
+
+    case Number::Type::UNSIGNED:
+      return Number(leaf.uint64_value);
+
+    case Number::Type::DOUBLE:
+      break;
+  }
+
+  return Number(leaf.double_value);
+}
+
+const FrozenConfig::Leaf* FrozenConfig::Find(std::string_view path) const {
+  if (leaves_.empty()) {
+    return nullptr;
+  }
+
+  int64_t displacement = displacements_[Hash(seed_, path) % displacements_.size()];
+  size_t slot = displacement < 0 ? static_cast<size_t>(-displacement - 1) : Hash(static_cast<uint64_t>(displacement), path) % leaves_.size();
+
+  const Leaf& leaf = leaves_[slot];
+  if (path != std::string_view(keys_.data() + leaf.key_offset, leaf.key_size)) {
+    return nullptr;
+  }
+
+  return &leaf;
+}
+}  // namespace config
+}  // namespace akrbt
\ No newline at end of file
@@ -0,0 +1,82 @@
+﻿#pragma once
+
+// #include <cstdint>
+#include <cstdint>
+// #include <string>
+#include <string>
+// #include <string_view>
+#include <string_view>
+// #include <vector>
+#include <vector>
+
+// #include "config.h"
+#include "config.h"
+
+namespace akrbt {
+namespace config {
+// Read-only snapshot of the leaves of a Value, keyed by Path. Paths go
+// through a minimal perfect hash straight to a slot in one contiguous leaf
+// table, so a lookup is one hash, one probe and one key comparison. Compile
+// again after every reload.
+class FrozenConfig {
+ public:
+  FrozenConfig();
+
+  static FrozenConfig Compile(const Value& value);
+
+  size_t size() const { return leaves_.size(); }
+  bool contains(std::string_view path) const { return Find(path) != nullptr; }
+  Value::Type type(std::string_view path) const;
+
+  // Return default_value if the path is missing or holds another type.
+  // Numbers convert between integer and floating point like Number does.
+  std::string_view get_string(std::string_view path, std::string_view default_value = std::string_view()) const;
+  int32_t get_integer(std::string_view path, int32_t default_value = 0) const;
+  int64_t get_int64(std::string_view path, int64_t default_value = 0) const;
+  double get_double(std::string_view path, double default_value = 0.0) const;
+  bool get_boolean(std::string_view path, bool default_value = false) const;
+
+ private:
+  // 24 bytes: the value shares its storage with the string's position.
+  struct Leaf {
+    uint32_t key_offset;
+    uint32_t key_size;
+    Value::Type type;
+    // Which member holds a number, so that it converts like Number.
+    Number::Type number_type;
+
+    union {
+      int64_t int64_value;
+      uint64_t uint64_value;
+      double double_value;
+      bool boolean_value;
+
+      struct {
+        uint32_t offset;
+        uint32_t size;
+      } string;
+    };
+  };
+
+  // Seeds tried for one bucket before starting over with another first
+  // level seed, and first level seeds tried before giving up.
+  static const uint64_t MAX_SEED = 1 << 16;
+  static const uint64_t MAX_ATTEMPTS = 16;
+
+  static uint64_t Hash(uint64_t seed, std::string_view key);
+  static Number ToNumber(const Leaf& leaf);
+
+  bool Place(const std::vector<Leaf>& leaves, uint64_t seed);
+  const Leaf* Find(std::string_view path) const;
+
+  // Seed that assigns keys to buckets.
+  uint64_t seed_;
+  // One entry per bucket: a seed to hash the bucket's keys with, or, for
+  // single-key buckets, -(slot + 1).
+  std::vector<int64_t> displacements_;
+  std::vector<Leaf> leaves_;
+  std::string keys_;
+  std::string strings_;
+};
+}  // namespace config
+}  // namespace akrbt
\ No newline at end of file
@@ -0,0 +1,286 @@
+﻿// #include "config-overlay.h"
+#include "config-overlay.h"
+
+// #include <algorithm>
+#include <algorithm>
+
+namespace akrbt {
+namespace config {
+namespace {
+const Value* Lookup(const Value& root, const std::string& path) {
+  const Value* current = &root;
+  size_t position = 0;
+  std::string_view segment;
+
+  while (Path::Next(path, position, segment)) {
+    if (current->is_object()) {
+      const std::string key(segment);
+      if (!current->has_field(key)) {
+        return nullptr;
+      }
+
+      current = &current->as_object().at(key);
+    } else if (current->is_array()) {
+      Array::size_type index;
+      if (!Path::ParseIndex(segment, index) || index >= current->as_array().size()) {
+        return nullptr;
+      }
+
+      current = &current->as_array().at(index);
+    } else {
+      return nullptr;
+    }
+  }
+
+  return current->is_null() ? nullptr : current;
+}
+
+// Merges with an explicit stack so that deeply nested layers cannot exhaust
+// the call stack.
+template <typename ArrayModeOf>
+void MergeValues(Value& base, const Value& upper, ArrayModeOf array_mode_of) {
+  struct Frame {
+    Value* base;
+    const Value* upper;
+    std::string path;
+  };
+
+  std::vector<Frame> frames;
+  frames.push_back(Frame{&base, &upper, std::string()});
+
+  while (!frames.empty()) {
+    Frame frame = std::move(frames.back());
+    frames.pop_back();
+
+    if (frame.upper->is_null()) {
+      continue;
+    }
+
+    if (frame.base->is_object() && frame.upper->is_object()) {
+      Object& base_object = frame.base->as_object();
+      const Object& upper_object = frame.upper->as_object();
+
+      // Insert every key first: taking references while the vector may still
+      // grow would leave them dangling.
+      for (auto& field : upper_object) {
+        if (!field.second.is_null()) {
+          base_object[field.first];
+        }
+      }
+
+      for (auto& field : upper_object) {
+        if (field.second.is_null()) {
+          continue;
+        }
+
+        Value& child = base_object.at(field.first);
+        if (child.is_null()) {
+          child = field.second;
+        } else {
+          frames.push_back(Frame{&child, &field.second, Path::Join(frame.path, field.first)});
+        }
+      }
+    } else if (frame.base->is_array() && frame.upper->is_array() && array_mode_of(frame.path) == Overlay::ArrayMode::APPEND) {
+      Array& base_array = frame.base->as_array();
+
+      for (auto& element : frame.upper->as_array()) {
+        base_array[base_array.size()] = element;
+      }
+    } else {
+      *frame.base = *frame.upper;
+    }
+  }
+}
+}  // namespace
+
+Overlay::Overlay() : Overlay(ArrayMode::REPLACE) {}
+Overlay::Overlay(ArrayMode array_mode) : array_mode_(array_mode), array_modes_(), layers_(), merged_(), dirty_from_(0) {}
+
+size_t Overlay::AddLayer(const std::string& name, Value layer) {
+  layer.Dedup();
+  layers_.push_back(Layer{name, std::move(layer)});
+  Invalidate(layers_.size() - 1);
+
+  return layers_.size() - 1;
+}
+
+void Overlay::SetLayer(size_t index, Value layer) {
+  if (index >= layers_.size()) {
+    throw Exception("index out of bounds");
+  }
+
+  layer.Dedup();
+  layers_[index].value = std::move(layer);
+  Invalidate(index);
+}
+
+void Overlay::SetLayer(const std::string& name, Value layer) { SetLayer(IndexOf(name), std::move(layer)); }
+
+const Value& Overlay::layer(size_t index) const {
+  if (index >= layers_.size()) {
+    throw Exception("index out of bounds");
+  }
+
+  return layers_[index].value;
+}
+
+const Value& Overlay::layer(const std::string& name) const { return layers_[IndexOf(name)].value; }
+
+void Overlay::SetArrayMode(ArrayMode array_mode) {
+  array_mode_ = array_mode;
+  Invalidate(0);
+}
+
+void Overlay::SetArrayMode(const std::string& path, ArrayMode array_mode) {
+  auto iter = std::find_if(array_modes_.begin(), array_modes_.end(), [&path](const std::pair<std::string, ArrayMode>& element) -> bool {
+    return element.first == path;
+  });
+
+  if (iter == array_modes_.end()) {
+    array_modes_.push_back(std::pair<std::string, ArrayMode>(path, array_mode));
+  } else {
+    iter->second = array_mode;
+  }
+
+  Invalidate(0);
+}
+
+const Value* Overlay::Find(const std::string& path) {
+  // Nodes at the current prefix, ordered from the lowest to the highest layer.
+  std::vector<const Value*> candidates;
+  for (auto& layer : layers_) {
+    if (!layer.value.is_null()) {
+      candidates.push_back(&layer.value);
+    }
+  }
+
+  std::string prefix;
+  std::string_view segment;
+  std::string key;
+  size_t position = 0;
+
+  while (!candidates.empty()) {
+    // Only the run of same-kind containers on top contributes; anything else
+    // below has been replaced.
+    const Value* top = candidates.back();
+    auto first = candidates.end() - 1;
+
+    if (top->is_object()) {
+      while (first != candidates.begin() && (*(first - 1))->is_object()) {
+        --first;
+      }
+    } else if (top->is_array() && ArrayModeAt(prefix) == ArrayMode::APPEND) {
+      while (first != candidates.begin() && (*(first - 1))->is_array()) {
+        --first;
+      }
+    }
+
+    candidates.erase(candidates.begin(), first);
+
+    if (!Path::Next(path, position, segment)) {
+      if (candidates.size() == 1) {
+        return candidates.front();
+      }
+
+      return Lookup(Flatten(), path);
+    }
+
+    std::vector<const Value*> next;
+
+    if (top->is_object()) {
+      key.assign(segment);
+
+      for (auto candidate : candidates) {
+        if (candidate->has_field(key)) {
+          const Value& child = candidate->as_object().at(key);
+
+          if (!child.is_null()) {
+            next.push_back(&child);
+          }
+        }
+      }
+    } else if (top->is_array()) {
+      Array::size_type index;
+      if (!Path::ParseIndex(segment, index)) {
+        return nullptr;
+      }
+
+      for (auto candidate : candidates) {
+        const Array& array = candidate->as_array();
+
+        if (index < array.size()) {
+          if (!array.at(index).is_null()) {
+            next.push_back(&array.at(index));
+          }
+
+          break;
+        }
+
+        index -= array.size();
+      }
+    }
+
+    Path::Append(prefix, segment);
+    candidates.swap(next);
+  }
+
+  return nullptr;
+}
+
+const Value& Overlay::Flatten() {
+  static const Value EMPTY;
+
+  if (layers_.empty()) {
+    return EMPTY;
+  }
+
+  merged_.resize(layers_.size());
+
+  // Layers and merged prefixes are kept frozen, so a copy shares all of the
+  // tree and merging only copies the containers on the paths it changes.
+  for (size_t i = dirty_from_; i < layers_.size(); ++i) {
+    if (i == 0) {
+      merged_[i] = layers_[i].value;
+    } else {
+      merged_[i] = merged_[i - 1];
+      MergeInto(merged_[i], layers_[i].value);
+      merged_[i].Dedup();
+    }
+  }
+
+  dirty_from_ = layers_.size();
+
+  return merged_.back();
+}
+
+void Overlay::Merge(Value& base, const Value& upper, ArrayMode array_mode) {
+  MergeValues(base, upper, [array_mode](const std::string&) -> ArrayMode { return array_mode; });
+}
+
+size_t Overlay::IndexOf(const std::string& name) const {
+  for (size_t i = 0; i < layers_.size(); ++i) {
+    if (layers_[i].name == name) {
+      return i;
+    }
+  }
+
+  throw Exception("layer not found");
+}
+
+Overlay::ArrayMode Overlay::ArrayModeAt(const std::string& path) const {
+  for (auto& element : array_modes_) {
+    if (element.first == path) {
+      return element.second;
+    }
+  }
+
+  return array_mode_;
+}
+
+void Overlay::Invalidate(size_t index) { dirty_from_ = std::min(dirty_from_, index); }
+
+void Overlay::MergeInto(Value& base, const Value& upper) const {
+  MergeValues(base, upper, [this](const std::string& path) -> ArrayMode { return ArrayModeAt(path); });
+}
+}  // namespace config
+}  // namespace akrbt
\ No newline at end of file
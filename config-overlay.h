@@ -0,0 +1,74 @@
+﻿#pragma once
+
+// #include <string>
+#include <string>
+// #include <utility>
+#include <utility>
+// #include <vector>
+#include <vector>
+
+// #include "config.h"
+#include "config.h"
+
+namespace akrbt {
+namespace config {
+// Ordered stack of config layers (e.g. base, region, cluster, host).
+// Layers added later take precedence. Objects are merged key by key, arrays
+// are replaced or appended according to ArrayMode, null fields are treated
+// as unset, and any other value replaces whatever lies below it. Nodes are
+// addressed by Path.
+class Overlay {
+ public:
+  enum class ArrayMode {
+    REPLACE,
+    APPEND,
+  };
+
+  Overlay();
+  explicit Overlay(ArrayMode array_mode);
+
+  size_t size() const { return layers_.size(); }
+
+  size_t AddLayer(const std::string& name, Value layer);
+  void SetLayer(size_t index, Value layer);
+  void SetLayer(const std::string& name, Value layer);
+  const Value& layer(size_t index) const;
+  const Value& layer(const std::string& name) const;
+
+  void SetArrayMode(ArrayMode array_mode);
+  void SetArrayMode(const std::string& path, ArrayMode array_mode);
+
+  // Resolves a path by precedence. Leaves and containers contributed by a
+  // single layer are returned straight from that layer; containers merged
+  // from several layers are served from the flattened view.
+  // Returns nullptr if the path does not exist. The pointer is invalidated
+  // by the next AddLayer(), SetLayer() or SetArrayMode().
+  const Value* Find(const std::string& path);
+
+  // Returns the merged tree. The result of every layer prefix is cached, so
+  // after SetLayer(i, ...) only layers i..size()-1 are merged again. Layers
+  // are deduplicated when added, and the prefixes share every subtree a
+  // layer leaves unchanged. The reference lives as long as Find() results.
+  const Value& Flatten();
+
+  static void Merge(Value& base, const Value& upper, ArrayMode array_mode);
+
+ private:
+  struct Layer {
+    std::string name;
+    Value value;
+  };
+
+  size_t IndexOf(const std::string& name) const;
+  ArrayMode ArrayModeAt(const std::string& path) const;
+  void Invalidate(size_t index);
+  void MergeInto(Value& base, const Value& upper) const;
+
+  ArrayMode array_mode_;
+  std::vector<std::pair<std::string, ArrayMode>> array_modes_;
+  std::vector<Layer> layers_;
+  std::vector<Value> merged_;
+  size_t dirty_from_;
+};
+}  // namespace config
+}  // namespace akrbt
\ No newline at end of file
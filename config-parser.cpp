@@ -0,0 +1,309 @@
+﻿// #include "config-parser.h"
+#include "config-parser.h"
+
+// #include <algorithm>
+#include <algorithm>
+// #include <charconv>
+#include <charconv>
+// #include <cstring>
+#include <cstring>
+// #include <string_view>
+#include <string_view>
+
+namespace akrbt {
+namespace config {
+namespace {
+bool IsSpace(char c) { return c == ' ' || c == '\t' || c == '\r' || c == '\n'; }
+
+bool IsName(const std::string& tag) {
+  return !tag.empty() && tag[0] != '#' && std::none_of(tag.begin(), tag.end(), [](char c) -> bool { return IsSpace(c) || c == '/' || c == '#'; });
+}
+
+template <typename T>
+bool ParseNumber(std::string_view text, T& value) {
+  auto result = std::from_chars(text.data(), text.data() + text.size(), value);
+  return result.ec == std::errc() && result.ptr == text.data() + text.size();
+}
+}  // namespace
+
+ValueBuilder::ValueBuilder() : ValueBuilder(nullptr) {}
+ValueBuilder::ValueBuilder(DedupStats* dedup) : value_(), parents_(), dedup_table_(dedup != nullptr ? std::make_unique<DedupTable>() : nullptr), dedup_(dedup) {}
+
+void ValueBuilder::OnBegin(const std::string& key, Value::Type type) {
+  Value& target = Target(key);
+
+  // A named block may be opened again; it then keeps its earlier fields.
+  if (target.type() != type) {
+    target = type == Value::Type::ARRAY ? Value::array() : Value::object();
+  }
+
+  parents_.push_back(&target);
+}
+
+void ValueBuilder::OnEnd() {
+  Value& closed = *parents_.back();
+  parents_.pop_back();
+
+  // A block opened again is unshared by its first new child.
+  if (dedup_table_) {
+    dedup_table_->Add(closed);
+  }
+}
+
+void ValueBuilder::OnValue(const std::string& key, Value value) {
+  Value& target = Target(key);
+  target = std::move(value);
+
+  if (dedup_table_) {
+    dedup_table_->Add(target);
+  }
+}
+
+Value ValueBuilder::Release() {
+  Value result;
+  result = std::move(value_);
+
+  // Drops the table's references, so that nodes only this tree uses can be
+  // modified in place again.
+  if (dedup_table_) {
+    dedup_->shared_nodes += dedup_table_->stats().shared_nodes;
+    dedup_->bytes_saved += dedup_table_->stats().bytes_saved;
+    dedup_table_ = std::make_unique<DedupTable>();
+  }
+
+  return result;
+}
+
+Value& ValueBuilder::Target(const std::string& key) {
+  if (parents_.empty()) {
+    return value_;
+  }
+
+  Value& parent = *parents_.back();
+  if (parent.is_array()) {
+    Array& array = parent.as_array();
+    return array[array.size()];
+  }
+
+  return parent.as_object()[key];
+}
+
+Parser::Parser() : handler_(nullptr), builder_(std::make_unique<ValueBuilder>()), frames_(), tag_(), in_tag_(false), in_quotes_(false), line_(1), max_tag_size_(DEFAULT_MAX_TAG_SIZE) {
+  handler_ = builder_.get();
+  frames_.push_back(Frame{Frame::Kind::ROOT, std::string(), Value::Type::NULL_VALUE});
+}
+
+Parser::Parser(ParseHandler& handler) : handler_(&handler), builder_(), frames_(), tag_(), in_tag_(false), in_quotes_(false), line_(1), max_tag_size_(DEFAULT_MAX_TAG_SIZE) {
+  frames_.push_back(Frame{Frame::Kind::ROOT, std::string(), Value::Type::NULL_VALUE});
+}
+
+Parser::~Parser() {}
+
+void Parser::Feed(const char* data, size_t size) {
+  const char* end = data + size;
+
+  while (data < end) {
+    if (!in_tag_) {
+      // Text outside of tags is ignored.
+      const char* open = static_cast<const char*>(std::memchr(data, '<', end - data));
+      line_ += std::count(data, open != nullptr ? open : end, '\n');
+
+      if (open == nullptr) {
+        return;
+      }
+
+      data = open + 1;
+      in_tag_ = true;
+      in_quotes_ = false;
+      tag_.clear();
+      continue;
+    }
+
+    const char* current = data;
+    while (current < end && (in_quotes_ || *current != '>')) {
+      if (*current == '"') {
+        in_quotes_ = !in_quotes_;
+      } else if (*current == '\n') {
+        line_++;
+      }
+
+      current++;
+    }
+
+    tag_.append(data, current);
+    if (tag_.size() > max_tag_size_) {
+      Fail("tag too long");
+    }
+
+    if (current == end) {
+      return;
+    }
+
+    data = current + 1;
+    in_tag_ = false;
+    HandleTag();
+  }
+}
+
+Value Parser::Finish() {
+  if (in_tag_) {
+    Fail("unexpected end of input");
+  }
+
+  if (frames_.size() > 1) {
+    Fail("unclosed tag");
+  }
+
+  if (frames_.back().type != Value::Type::NULL_VALUE) {
+    frames_.back().type = Value::Type::NULL_VALUE;
+    handler_->OnEnd();
+  }
+
+  return builder_ ? builder_->Release() : Value();
+}
+
+void Parser::HandleTag() {
+  if (tag_ == "#Array") {
+    Open(Frame::Kind::ARRAY, std::string(), Value::Type::ARRAY);
+  } else if (tag_ == "Array#") {
+    Close(Frame::Kind::ARRAY, std::string());
+  } else if (tag_ == "#Object") {
+    Open(Frame::Kind::OBJECT, std::string(), Value::Type::OBJECT);
+  } else if (tag_ == "Object#") {
+    Close(Frame::Kind::OBJECT, std::string());
+  } else if (!tag_.empty() && tag_[0] == '/') {
+    Close(Frame::Kind::NAMED, tag_.substr(1));
+  } else if (tag_.find('=') != std::string::npos) {
+    HandleData();
+  } else if (IsName(tag_)) {
+    Open(Frame::Kind::NAMED, tag_, Value::Type::NULL_VALUE);
+  } else {
+    Fail("invalid tag <" + tag_ + ">");
+  }
+}
+
+void Parser::HandleData() {
+  std::string_view tag(tag_);
+  std::string_view key, type, value;
+  bool has_key = false, has_type = false, has_value = false;
+
+  for (size_t position = 0;;) {
+    while (position < tag.size() && IsSpace(tag[position])) {
+      position++;
+    }
+
+    if (position == tag.size()) {
+      break;
+    }
+
+    size_t equals = tag.find('=', position);
+    if (equals == std::string_view::npos || equals + 1 >= tag.size() || tag[equals + 1] != '"') {
+      Fail("invalid attribute");
+    }
+
+    size_t quote = tag.find('"', equals + 2);
+    if (quote == std::string_view::npos) {
+      Fail("invalid attribute");
+    }
+
+    std::string_view name = tag.substr(position, equals - position);
+    std::string_view text = tag.substr(equals + 2, quote - equals - 2);
+
+    if (name == "key") {
+      key = text;
+      has_key = true;
+    } else if (name == "type") {
+      type = text;
+      has_type = true;
+    } else if (name == "value") {
+      value = text;
+      has_value = true;
+    } else {
+      Fail("unknown attribute " + std::string(name));
+    }
+
+    position = quote + 1;
+  }
+
+  if (!has_type || !has_value) {
+    Fail("missing type or value");
+  }
+
+  Value data;
+  if (type == "String") {
+    data = Value::string(std::string(value));
+  } else if (type == "Number") {
+    int64_t int64_value;
+    uint64_t uint64_value;
+    double double_value;
+
+    // A fraction, an exponent, inf or nan make a double.
+    if (value.find_first_of(".eEnN") != std::string_view::npos) {
+      if (!ParseNumber(value, double_value)) {
+        Fail("invalid number " + std::string(value));
+      }
+
+      data = Value::number(double_value);
+    } else if (ParseNumber(value, int64_value)) {
+      data = Value::number(int64_value);
+    } else if (ParseNumber(value, uint64_value)) {
+      data = Value::number(uint64_value);
+    } else {
+      Fail("invalid number " + std::string(value));
+    }
+  } else if (type == "Boolean") {
+    data = Value::boolean(value != "false");
+  } else {
+    Fail("unknown type " + std::string(type));
+  }
+
+  if (has_key) {
+    Decide(Value::Type::OBJECT);
+    handler_->OnValue(std::string(key), std::move(data));
+  } else {
+    Decide(Value::Type::ARRAY);
+    handler_->OnValue(std::string(), std::move(data));
+  }
+}
+
+void Parser::Open(Frame::Kind kind, std::string key, Value::Type type) {
+  Decide(kind == Frame::Kind::NAMED ? Value::Type::OBJECT : Value::Type::ARRAY);
+  frames_.push_back(Frame{kind, std::move(key), type});
+
+  if (type != Value::Type::NULL_VALUE) {
+    handler_->OnBegin(frames_.back().key, type);
+  }
+}
+
+void Parser::Close(Frame::Kind kind, const std::string& name) {
+  if (frames_.size() == 1 || frames_.back().kind != kind || frames_.back().key != name) {
+    Fail("unexpected closing tag <" + tag_ + ">");
+  }
+
+  Frame frame = std::move(frames_.back());
+  frames_.pop_back();
+
+  // A block closed before any child is an empty (null) field.
+  if (frame.type == Value::Type::NULL_VALUE) {
+    handler_->OnValue(frame.key, Value());
+  } else {
+    handler_->OnEnd();
+  }
+}
+
+// The type of a block is known once its first child is seen: keyed data and
+// named blocks make it an object, anything else an array.
+void Parser::Decide(Value::Type type) {
+  Frame& frame = frames_.back();
+
+  if (frame.type == Value::Type::NULL_VALUE) {
+    frame.type = type;
+    handler_->OnBegin(frame.key, type);
+  } else if (frame.type != type) {
+    Fail(type == Value::Type::OBJECT ? "keyed field inside an array" : "field without key inside an object");
+  }
+}
+
+void Parser::Fail(const std::string& message) const { throw Exception("invalid config format: " + message + " (line " + std::to_string(line_) + ")"); }
+}  // namespace config
+}  // namespace akrbt
\ No newline at end of file
@@ -0,0 +1,103 @@
+﻿#pragma once
+
+// #include <memory>
+#include <memory>
+// #include <string>
+#include <string>
+// #include <vector>
+#include <vector>
+
+// #include "config.h"
+#include "config.h"
+
+namespace akrbt {
+namespace config {
+// Receives the parse as a stream of events. key is empty for the root and
+// for array elements. A named block is reported once its type is known from
+// its first child; an empty one is reported as a null value.
+class ParseHandler {
+ public:
+  virtual void OnBegin(const std::string& key, Value::Type type) {}
+  virtual void OnEnd() {}
+  virtual void OnValue(const std::string& key, Value value) {}
+
+  virtual ~ParseHandler() {}
+};
+
+// Handler that assembles the events into a Value. If dedup is set, every
+// finished leaf and container goes through a DedupTable right away, so
+// repeated subtrees are released while the input is still being parsed;
+// Release() adds the savings to *dedup.
+class ValueBuilder : public ParseHandler {
+ public:
+  ValueBuilder();
+  explicit ValueBuilder(DedupStats* dedup);
+
+  virtual void OnBegin(const std::string& key, Value::Type type);
+  virtual void OnEnd();
+  virtual void OnValue(const std::string& key, Value value);
+
+  Value Release();
+
+ private:
+  Value& Target(const std::string& key);
+
+  Value value_;
+  std::vector<Value*> parents_;
+  std::unique_ptr<DedupTable> dedup_table_;
+  DedupStats* dedup_;
+};
+
+// Push parser: input can be fed in chunks of any size, split anywhere, even
+// inside a tag. Apart from the result, memory is bounded by the longest tag
+// and the nesting depth.
+class Parser {
+ public:
+  static const size_t DEFAULT_MAX_TAG_SIZE = 1 << 20;
+
+  // Builds a Value, returned by Finish().
+  Parser();
+  // Streams events to handler; Finish() then returns null.
+  explicit Parser(ParseHandler& handler);
+
+  Parser(const Parser&) = delete;
+  Parser& operator=(const Parser&) = delete;
+  ~Parser();
+
+  void set_max_tag_size(size_t max_tag_size) { max_tag_size_ = max_tag_size; }
+
+  void Feed(const char* data, size_t size);
+  Value Finish();
+
+ private:
+  struct Frame {
+    enum class Kind {
+      ROOT,
+      NAMED,
+      ARRAY,
+      OBJECT,
+    };
+
+    Kind kind;
+    std::string key;
+    Value::Type type;
+  };
+
+  void HandleTag();
+  void HandleData();
+  void Open(Frame::Kind kind, std::string key, Value::Type type);
+  void Close(Frame::Kind kind, const std::string& name);
+  void Decide(Value::Type type);
+  [[noreturn]] void Fail(const std::string& message) const;
+
+  ParseHandler* handler_;
+  std::unique_ptr<ValueBuilder> builder_;
+  std::vector<Frame> frames_;
+  std::string tag_;
+  bool in_tag_;
+  bool in_quotes_;
+  size_t line_;
+  size_t max_tag_size_;
+};
+}  // namespace config
+}  // namespace akrbt
\ No newline at end of file
@@ -0,0 +1,438 @@
+﻿// #include "config-schema.h"
+#include "config-schema.h"
+
+// #include <algorithm>
+#include <algorithm>
+// #include <fstream>
+#include <fstream>
+// #include <sstream>
+#include <sstream>
+// #include <utility>
+#include <utility>
+
+namespace akrbt {
+namespace config {
+namespace {
+const char* TypeName(Value::Type type) {
+  switch (type) {
+    case Value::Type::STRING:
+      return "String";
+
+    case Value::Type::NUMBER:
+      return "Number";
+
+    case Value::Type::BOOLEAN:
+      return "Boolean";
+
+    case Value::Type::ARRAY:
+      return "Array";
+
+    case Value::Type::OBJECT:
+      return "Object";
+
+    default:
+      return "Null";
+  }
+}
+}  // namespace
+
+Schema::Schema(Value::Type type)
+    : type_(type), has_range_(false), min_(0.0), max_(0.0), allow_extra_(false), element_(), keys_(), fields_(), required_() {}
+
+Schema Schema::any() { return Schema(Value::Type::NULL_VALUE); }
+Schema Schema::string() { return Schema(Value::Type::STRING); }
+Schema Schema::number() { return Schema(Value::Type::NUMBER); }
+Schema Schema::boolean() { return Schema(Value::Type::BOOLEAN); }
+Schema Schema::array() { return Schema(Value::Type::ARRAY); }
+Schema Schema::object() { return Schema(Value::Type::OBJECT); }
+
+Schema Schema::array(Schema element) {
+  Schema schema(Value::Type::ARRAY);
+  schema.element_.push_back(std::move(element));
+
+  return schema;
+}
+
+Schema& Schema::range(double min, double max) {
+  if (type_ != Value::Type::NUMBER) {
+    throw Exception("not a number schema");
+  }
+
+  has_range_ = true;
+  min_ = min;
+  max_ = max;
+
+  return *this;
+}
+
+Schema& Schema::required(const std::string& key, Schema schema) {
+  if (type_ != Value::Type::OBJECT) {
+    throw Exception("not an object schema");
+  }
+
+  keys_.push_back(key);
+  fields_.push_back(std::move(schema));
+  required_.push_back(true);
+
+  return *this;
+}
+
+Schema& Schema::optional(const std::string& key, Schema schema) {
+  if (type_ != Value::Type::OBJECT) {
+    throw Exception("not an object schema");
+  }
+
+  keys_.push_back(key);
+  fields_.push_back(std::move(schema));
+  required_.push_back(false);
+
+  return *this;
+}
+
+Schema& Schema::allow_extra(bool allow) {
+  if (type_ != Value::Type::OBJECT) {
+    throw Exception("not an object schema");
+  }
+
+  allow_extra_ = allow;
+
+  return *this;
+}
+
+CompiledSchema Schema::Compile() const {
+  CompiledSchema compiled;
+  std::vector<std::pair<const Schema*, int32_t>> pending;
+
+  compiled.states_.emplace_back();
+  pending.push_back(std::pair<const Schema*, int32_t>(this, 0));
+
+  while (!pending.empty()) {
+    const Schema& schema = *pending.back().first;
+    int32_t index = pending.back().second;
+    pending.pop_back();
+
+    auto add = [&compiled, &pending](const Schema& child) -> int32_t {
+      if (child.type_ == Value::Type::NULL_VALUE) {
+        return CompiledSchema::ANY;
+      }
+
+      compiled.states_.emplace_back();
+      pending.push_back(std::pair<const Schema*, int32_t>(&child, static_cast<int32_t>(compiled.states_.size() - 1)));
+
+      return static_cast<int32_t>(compiled.states_.size() - 1);
+    };
+
+    int32_t element = schema.element_.empty() ? CompiledSchema::ANY : add(schema.element_.front());
+
+    std::vector<int32_t> field_states;
+    for (auto& field : schema.fields_) {
+      field_states.push_back(add(field));
+    }
+
+    CompiledSchema::State& state = compiled.states_[index];
+    state.type = schema.type_;
+    state.has_range = schema.has_range_;
+    state.min = schema.min_;
+    state.max = schema.max_;
+    state.allow_extra = schema.allow_extra_;
+    state.element = element;
+
+    for (size_t i = 0; i < schema.keys_.size(); ++i) {
+      if (state.fields.emplace(schema.keys_[i], state.field_keys.size()).second) {
+        state.field_keys.push_back(schema.keys_[i]);
+        state.field_states.push_back(field_states[i]);
+        state.required.push_back(schema.required_[i]);
+      }
+    }
+  }
+
+  return compiled;
+}
+
+ValidationResult CompiledSchema::Load(const std::string& file_path) const {
+  std::ifstream input_file(file_path, std::ios::binary);
+  if (!input_file.is_open()) {
+    throw Exception("cannot open file");
+  }
+
+  return Load(input_file);
+}
+
+ValidationResult CompiledSchema::Load(std::istream& input) const {
+  static const size_t CHUNK_SIZE = 64 * 1024;
+
+  ValueBuilder builder;
+  SchemaValidator validator(*this, &builder);
+  Parser parser(validator);
+  std::vector<char> buffer(CHUNK_SIZE);
+
+  while (input) {
+    input.read(buffer.data(), buffer.size());
+    parser.Feed(buffer.data(), static_cast<size_t>(input.gcount()));
+  }
+
+  parser.Finish();
+  validator.Finish();
+
+  ValidationResult result;
+  result.violations = validator.violations();
+
+  if (result.ok()) {
+    result.value = builder.Release();
+  }
+
+  return result;
+}
+
+std::vector<Violation> CompiledSchema::Validate(const Value& value) const {
+  SchemaValidator validator(*this, nullptr);
+
+  Walker walker(value);
+  while (walker.Next()) {
+    if (walker.is_leaving()) {
+      validator.OnEnd();
+    } else if (walker.is_container()) {
+      validator.OnBegin(walker.key(), walker.value().type());
+    } else {
+      validator.CheckValue(walker.key(), walker.value());
+    }
+  }
+
+  if (value.is_null()) {
+    validator.Finish();
+  }
+
+  return validator.violations();
+}
+
+SchemaValidator::SchemaValidator(const CompiledSchema& schema, ParseHandler* next, bool fail_fast)
+    : schema_(&schema), next_(next), fail_fast_(fail_fast), started_(false), forwarding_(next != nullptr), frames_(), violations_() {}
+
+void SchemaValidator::OnBegin(const std::string& key, Value::Type type) {
+  std::string segment;
+  int32_t state = 0;
+
+  if (frames_.empty()) {
+    started_ = true;
+  } else {
+    state = Child(key, segment);
+  }
+
+  if (!CheckType(state, type, segment)) {
+    state = CompiledSchema::ANY;
+  }
+
+  Frame frame{state, std::move(segment), nullptr, nullptr};
+  if (frames_.empty() || frames_.back().block->type == Value::Type::ARRAY) {
+    frame.owned = NewBlock(state, type);
+    frame.block = frame.owned.get();
+  } else {
+    frame.block = &Reopen(*frames_.back().block, key, state, type);
+  }
+
+  frames_.push_back(std::move(frame));
+
+  if (forwarding_) {
+    next_->OnBegin(key, type);
+  }
+}
+
+void SchemaValidator::OnEnd() {
+  if (frames_.back().owned) {
+    CheckRequired(*frames_.back().owned);
+  }
+
+  frames_.pop_back();
+
+  if (forwarding_) {
+    next_->OnEnd();
+  }
+}
+
+void SchemaValidator::OnValue(const std::string& key, Value value) {
+  CheckValue(key, value);
+
+  if (forwarding_) {
+    next_->OnValue(key, std::move(value));
+  }
+}
+
+void SchemaValidator::Finish() {
+  if (!started_) {
+    CheckRequired(*NewBlock(0, schema_->states_[0].type));
+  }
+}
+
+std::unique_ptr<SchemaValidator::Block> SchemaValidator::NewBlock(int32_t state, Value::Type type) const {
+  std::unique_ptr<Block> block(new Block{state, type, std::vector<bool>(), 0, {}});
+
+  if (state != CompiledSchema::ANY) {
+    block->seen.assign(schema_->states_[state].field_keys.size(), false);
+  }
+
+  return block;
+}
+
+// The block for a named block in parent. One opened before continues, unless
+// it has another type; then, like in ValueBuilder, it starts over.
+SchemaValidator::Block& SchemaValidator::Reopen(Block& parent, const std::string& key, int32_t state, Value::Type type) {
+  for (auto& child : parent.children) {
+    if (child.first == key) {
+      if (child.second->state != state || child.second->type != type) {
+        child.second = NewBlock(state, type);
+      }
+
+      return *child.second;
+    }
+  }
+
+  parent.children.push_back(std::pair<std::string, std::unique_ptr<Block>>(key, NewBlock(state, type)));
+  return *parent.children.back().second;
+}
+
+// Drops what an object knew about key, before a value replaces it.
+void SchemaValidator::Forget(Block& parent, const std::string& key) {
+  if (parent.state != CompiledSchema::ANY) {
+    const CompiledSchema::State& state = schema_->states_[parent.state];
+    auto iter = state.fields.find(key);
+
+    if (iter != state.fields.end()) {
+      parent.seen[iter->second] = false;
+    }
+  }
+
+  parent.children.erase(std::remove_if(parent.children.begin(), parent.children.end(),
+                                       [&key](const std::pair<std::string, std::unique_ptr<Block>>& child) -> bool { return child.first == key; }),
+                        parent.children.end());
+}
+
+// Resolves the state of a child of the innermost container and marks a
+// known key as seen. Sets segment to the child's key or index.
+int32_t SchemaValidator::Child(const std::string& key, std::string& segment) {
+  Frame& parent = frames_.back();
+
+  if (parent.block->type == Value::Type::ARRAY) {
+    segment = std::to_string(parent.block->size++);
+    return parent.state == CompiledSchema::ANY ? CompiledSchema::ANY : schema_->states_[parent.state].element;
+  }
+
+  segment = key;
+  if (parent.state == CompiledSchema::ANY) {
+    return CompiledSchema::ANY;
+  }
+
+  const CompiledSchema::State& state = schema_->states_[parent.state];
+  auto iter = state.fields.find(key);
+
+  if (iter == state.fields.end()) {
+    if (!state.allow_extra) {
+      Report(segment, "unexpected key");
+    }
+
+    return CompiledSchema::ANY;
+  }
+
+  parent.block->seen[iter->second] = true;
+  return state.field_states[iter->second];
+}
+
+bool SchemaValidator::CheckType(int32_t state, Value::Type type, const std::string& segment) {
+  if (state == CompiledSchema::ANY) {
+    return true;
+  }
+
+  Value::Type expected = schema_->states_[state].type;
+  if (expected != Value::Type::NULL_VALUE && expected != type) {
+    Report(segment, std::string("expected ") + TypeName(expected) + ", got " + TypeName(type));
+    return false;
+  }
+
+  return true;
+}
+
+void SchemaValidator::CheckValue(const std::string& key, const Value& value) {
+  // A value replaces a field, or a block, of the same key. A null field
+  // counts as absent; it still takes its place in an array.
+  if (!frames_.empty() && frames_.back().block->type == Value::Type::OBJECT) {
+    Forget(*frames_.back().block, key);
+  }
+
+  if (value.is_null()) {
+    if (!frames_.empty() && frames_.back().block->type == Value::Type::ARRAY) {
+      frames_.back().block->size++;
+    }
+
+    return;
+  }
+
+  std::string segment;
+  int32_t state = frames_.empty() ? 0 : Child(key, segment);
+
+  if (!CheckType(state, value.type(), segment) || state == CompiledSchema::ANY) {
+    return;
+  }
+
+  const CompiledSchema::State& expected = schema_->states_[state];
+  if (expected.has_range) {
+    double number = value.get_if<Number>()->to_double();
+
+    if (number < expected.min || number > expected.max) {
+      std::ostringstream message;
+      message << "out of range [" << expected.min << ", " << expected.max << "]";
+      Report(segment, message.str());
+    }
+  }
+}
+
+// Checks block and the named blocks inside it, which can no longer be opened
+// again. Paths are relative to the innermost open container.
+void SchemaValidator::CheckRequired(const Block& block) {
+  std::vector<std::pair<const Block*, std::string>> pending;
+  pending.push_back(std::pair<const Block*, std::string>(&block, std::string()));
+
+  while (!pending.empty()) {
+    const Block& current = *pending.back().first;
+    std::string path = std::move(pending.back().second);
+    pending.pop_back();
+
+    if (current.state != CompiledSchema::ANY) {
+      const CompiledSchema::State& expected = schema_->states_[current.state];
+
+      for (size_t i = 0; i < expected.field_keys.size(); ++i) {
+        if (expected.required[i] && !current.seen[i]) {
+          Report(Path::Join(path, expected.field_keys[i]), "missing required key");
+        }
+      }
+    }
+
+    for (auto child = current.children.rbegin(); child != current.children.rend(); ++child) {
+      pending.push_back(std::pair<const Block*, std::string>(child->second.get(), Path::Join(path, child->first)));
+    }
+  }
+}
+
+// Reports a violation at segment below the innermost open container.
+void SchemaValidator::Report(const std::string& segment, const std::string& message) {
+  violations_.push_back(Violation{PathTo(segment), message});
+  forwarding_ = false;
+
+  if (fail_fast_) {
+    throw Exception(violations_.back().path + ": " + message);
+  }
+}
+
+std::string SchemaValidator::PathTo(const std::string& segment) const {
+  std::string path;
+
+  for (size_t i = 1; i < frames_.size(); ++i) {
+    Path::Append(path, frames_[i].segment);
+  }
+
+  if (!segment.empty()) {
+    Path::Append(path, segment);
+  }
+
+  return path;
+}
+}  // namespace config
+}  // namespace akrbt
\ No newline at end of file
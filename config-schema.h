@@ -0,0 +1,180 @@
+﻿#pragma once
+
+// #include <istream>
+#include <istream>
+// #include <memory>
+#include <memory>
+// #include <string>
+#include <string>
+// #include <unordered_map>
+#include <unordered_map>
+// #include <vector>
+#include <vector>
+
+// #include "config.h"
+#include "config.h"
+// #include "config-parser.h"
+#include "config-parser.h"
+
+namespace akrbt {
+namespace config {
+class CompiledSchema;
+
+// Describes the expected shape of a config:
+//
+//   Schema schema = Schema::object()
+//                       .required("name", Schema::string())
+//                       .optional("port", Schema::number().range(1, 65535))
+//                       .optional("hosts", Schema::array(Schema::string()));
+//
+// Objects reject keys they do not list unless allow_extra() is set. Null
+// fields count as absent.
+class Schema {
+ public:
+  static Schema any();
+  static Schema string();
+  static Schema number();
+  static Schema boolean();
+  static Schema array();
+  static Schema array(Schema element);
+  static Schema object();
+
+  Schema& range(double min, double max);
+  Schema& required(const std::string& key, Schema schema);
+  Schema& optional(const std::string& key, Schema schema);
+  Schema& allow_extra(bool allow = true);
+
+  CompiledSchema Compile() const;
+
+ private:
+  friend class CompiledSchema;
+
+  explicit Schema(Value::Type type);
+
+  Value::Type type_;
+  bool has_range_;
+  double min_;
+  double max_;
+  bool allow_extra_;
+  std::vector<Schema> element_;
+  std::vector<std::string> keys_;
+  std::vector<Schema> fields_;
+  std::vector<bool> required_;
+};
+
+struct Violation {
+  // See Path.
+  std::string path;
+  std::string message;
+};
+
+struct ValidationResult {
+  // Null if there are violations.
+  Value value;
+  std::vector<Violation> violations;
+
+  bool ok() const { return violations.empty(); }
+};
+
+// A Schema flattened into a table of states, one per schema node, with
+// object keys resolved through a hash map. It is checked against parse
+// events as they arrive, so a config is validated in the same pass that
+// reads it.
+class CompiledSchema {
+ public:
+  ValidationResult Load(const std::string& file_path) const;
+  ValidationResult Load(std::istream& input) const;
+  std::vector<Violation> Validate(const Value& value) const;
+
+ private:
+  friend class Schema;
+  friend class SchemaValidator;
+
+  static const int32_t ANY = -1;
+
+  struct State {
+    Value::Type type;
+    bool has_range;
+    double min;
+    double max;
+    bool allow_extra;
+    int32_t element;
+    // Key to field index; field i goes to states[field_states[i]].
+    std::unordered_map<std::string, size_t> fields;
+    std::vector<std::string> field_keys;
+    std::vector<int32_t> field_states;
+    std::vector<bool> required;
+  };
+
+  CompiledSchema() : states_() {}
+
+  std::vector<State> states_;
+};
+
+// Validates parse events against a CompiledSchema and forwards them to next,
+// if given, until the first violation; after that nothing more is built.
+// With fail_fast the first violation throws an Exception, which stops the
+// parse right there.
+//
+// A named block opened again continues where it left off, as in
+// ValueBuilder, so required keys are checked once the root or the array
+// element around it closes. A violation in a value that a later field or
+// block replaces is still reported.
+class SchemaValidator : public ParseHandler {
+ public:
+  SchemaValidator(const CompiledSchema& schema, ParseHandler* next, bool fail_fast = false);
+
+  virtual void OnBegin(const std::string& key, Value::Type type);
+  virtual void OnEnd();
+  virtual void OnValue(const std::string& key, Value value);
+
+  // Reports what an empty input is missing. Call after Parser::Finish().
+  void Finish();
+
+  const std::vector<Violation>& violations() const { return violations_; }
+
+ private:
+  friend class CompiledSchema;
+
+  // What a container holds so far: the fields seen in an object, the size
+  // of an array, and the named blocks inside. Kept until the root or array
+  // element around it closes, because until then a named block can be
+  // opened again.
+  struct Block {
+    int32_t state;
+    Value::Type type;
+    std::vector<bool> seen;
+    Array::size_type size;
+    // By key, in the order they were first opened.
+    std::vector<std::pair<std::string, std::unique_ptr<Block>>> children;
+  };
+
+  struct Frame {
+    int32_t state;
+    // Path segment of this container: its key, or its index in an array.
+    std::string segment;
+    Block* block;
+    // Set for the root and array elements, which cannot be opened again.
+    std::unique_ptr<Block> owned;
+  };
+
+  std::unique_ptr<Block> NewBlock(int32_t state, Value::Type type) const;
+  Block& Reopen(Block& parent, const std::string& key, int32_t state, Value::Type type);
+  void Forget(Block& parent, const std::string& key);
+  int32_t Child(const std::string& key, std::string& segment);
+  bool CheckType(int32_t state, Value::Type type, const std::string& segment);
+  void CheckValue(const std::string& key, const Value& value);
+  void CheckRequired(const Block& block);
+  void Report(const std::string& segment, const std::string& message);
+  std::string PathTo(const std::string& segment) const;
+
+  const CompiledSchema* schema_;
+  ParseHandler* next_;
+  bool fail_fast_;
+  bool started_;
+  bool forwarding_;
+  std::vector<Frame> frames_;
+  std::vector<Violation> violations_;
+};
+}  // namespace config
+}  // namespace akrbt
\ No newline at end of file
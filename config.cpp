@@ -1,32 +1,200 @@
 ﻿// #include "config.h"
 #include "config.h"
+// #include "config-parser.h"
+#include "config-parser.h"
 
+// #include <atomic>
+#include <atomic>
+// #include <filesystem>
+#include <filesystem>
 // #include <fstream>
 #include <fstream>
-// #include <regex>
-#include <regex>
+// #include <thread>
+#include <thread>
+// #include <unordered_map>
+#include <unordered_map>
+
+#ifdef __linux__
+// #include <fcntl.h>
+#include <fcntl.h>
+// #include <unistd.h>
+#include <unistd.h>
+#endif
 
 namespace akrbt {
 namespace config {
-Value::Value() : value_(std::make_unique<details::_Null>()) {}
-Value::Value(const std::string& value) : value_(std::make_unique<details::_String>(value)) {}
-Value::Value(int32_t value) : value_(std::make_unique<details::_Number>(value)) {}
-Value::Value(int64_t value) : value_(std::make_unique<details::_Number>(value)) {}
-Value::Value(uint32_t value) : value_(std::make_unique<details::_Number>(value)) {}
-Value::Value(uint64_t value) : value_(std::make_unique<details::_Number>(value)) {}
-Value::Value(double value) : value_(std::make_unique<details::_Number>(value)) {}
-Value::Value(bool value) : value_(std::make_unique<details::_Boolean>(value)) {}
-
-Value::Value(std::unique_ptr<details::_Value> value) : value_(std::move(value)) {}
-Value::Value(const Value& other) : value_(other.value_->Copy()) {}
-Value::Value(Value&& other) noexcept : value_(std::move(other.value_)) {}
-
-bool Value::is_null() const { return value_->is_null(); }
-bool Value::is_string() const { return value_->is_string(); }
-bool Value::is_number() const { return value_->is_number(); }
-bool Value::is_boolean() const { return value_->is_boolean(); }
-bool Value::is_array() const { return value_->is_array(); }
-bool Value::is_object() const { return value_->is_object(); }
+namespace details {
+void InvalidateTreeHashes(const _Value* node) {
+  for (; node != nullptr; node = node->parent()) {
+    node->InvalidateTreeHash();
+  }
+}
+}  // namespace details
+
+namespace {
+bool IsLastContainerOwner(const std::shared_ptr<details::_Value>& value) {
+  return value && value.use_count() == 1 && (value->type() == Value::Type::ARRAY || value->type() == Value::Type::OBJECT);
+}
+
+// Compares the data of two nodes and, for containers, their sizes and keys.
+bool IsSameShape(const details::_Value& lhs, const details::_Value& rhs) {
+  if (lhs.type() != rhs.type()) {
+    return false;
+  }
+
+  switch (lhs.type()) {
+    case Value::Type::NULL_VALUE:
+      return true;
+
+    case Value::Type::STRING:
+      return static_cast<const details::_String&>(lhs).value() == static_cast<const details::_String&>(rhs).value();
+
+    case Value::Type::NUMBER:
+      return static_cast<const details::_Number&>(lhs).number() == static_cast<const details::_Number&>(rhs).number();
+
+    case Value::Type::BOOLEAN:
+      return static_cast<const details::_Boolean&>(lhs).value() == static_cast<const details::_Boolean&>(rhs).value();
+
+    case Value::Type::ARRAY:
+      return static_cast<const details::_Array&>(lhs).array().size() == static_cast<const details::_Array&>(rhs).array().size();
+
+    case Value::Type::OBJECT: {
+      const Object& lhs_object = static_cast<const details::_Object&>(lhs).object();
+      const Object& rhs_object = static_cast<const details::_Object&>(rhs).object();
+
+      return lhs_object.size() == rhs_object.size() &&
+             std::equal(lhs_object.begin(), lhs_object.end(), rhs_object.begin(),
+                        [](const std::pair<std::string, Value>& lhs_field, const std::pair<std::string, Value>& rhs_field) -> bool {
+                          return lhs_field.first == rhs_field.first;
+                        });
+    }
+  }
+
+  return false;
+}
+
+// Shallow comparison used by Dedup(): children are compared by address.
+bool IsSameNode(const details::_Value& lhs, const details::_Value& rhs) {
+  if (!IsSameShape(lhs, rhs)) {
+    return false;
+  }
+
+  if (lhs.type() == Value::Type::ARRAY) {
+    const Array& lhs_array = static_cast<const details::_Array&>(lhs).array();
+    const Array& rhs_array = static_cast<const details::_Array&>(rhs).array();
+
+    return std::equal(lhs_array.begin(), lhs_array.end(), rhs_array.begin(), [](const Value& lhs_element, const Value& rhs_element) -> bool {
+      return lhs_element.is_same(rhs_element);
+    });
+  }
+
+  if (lhs.type() == Value::Type::OBJECT) {
+    const Object& lhs_object = static_cast<const details::_Object&>(lhs).object();
+    const Object& rhs_object = static_cast<const details::_Object&>(rhs).object();
+
+    return std::equal(lhs_object.begin(), lhs_object.end(), rhs_object.begin(),
+                      [](const std::pair<std::string, Value>& lhs_field, const std::pair<std::string, Value>& rhs_field) -> bool {
+                        return lhs_field.second.is_same(rhs_field.second);
+                      });
+  }
+
+  return true;
+}
+}  // namespace
+
+void DedupTable::Add(Value& value) {
+  // Two nodes are identical exactly when their own data and the addresses
+  // of their children match.
+  const details::_Value& node = *value.value_;
+  size_t hash = node.Hash();
+
+  if (node.type() == Value::Type::ARRAY) {
+    for (auto& element : static_cast<const details::_Array&>(node).array()) {
+      hash = details::HashCombine(hash, std::hash<const void*>()(element.value_.get()));
+    }
+  } else if (node.type() == Value::Type::OBJECT) {
+    for (auto& field : static_cast<const details::_Object&>(node).object()) {
+      hash = details::HashCombine(hash, std::hash<std::string>()(field.first));
+      hash = details::HashCombine(hash, std::hash<const void*>()(field.second.value_.get()));
+    }
+  }
+
+  auto range = nodes_.equal_range(hash);
+  auto iter = std::find_if(range.first, range.second, [&node](const std::pair<const size_t, std::shared_ptr<details::_Value>>& element) -> bool {
+    return IsSameNode(*element.second, node);
+  });
+
+  if (iter == range.second) {
+    value.value_->Freeze();
+    nodes_.emplace(hash, value.value_);
+  } else if (iter->second != value.value_) {
+    if (value.value_.use_count() == 1) {
+      stats_.shared_nodes++;
+      stats_.bytes_saved += node.Footprint();
+    }
+
+    value.value_ = iter->second;
+  }
+}
+
+Value::Value() : value_(std::make_shared<details::_Null>()) {}
+Value::Value(const std::string& value) : value_(std::make_shared<details::_String>(value)) {}
+Value::Value(int32_t value) : value_(std::make_shared<details::_Number>(value)) {}
+Value::Value(int64_t value) : value_(std::make_shared<details::_Number>(value)) {}
+Value::Value(uint32_t value) : value_(std::make_shared<details::_Number>(value)) {}
+Value::Value(uint64_t value) : value_(std::make_shared<details::_Number>(value)) {}
+Value::Value(double value) : value_(std::make_shared<details::_Number>(value)) {}
+Value::Value(bool value) : value_(std::make_shared<details::_Boolean>(value)) {}
+
+Value::Value(std::shared_ptr<details::_Value> value) : value_(std::move(value)) {}
+Value::Value(const Value& other) : value_() { *this = other; }
+Value::Value(Value&& other) noexcept : value_(std::move(other.value_)) {
+  // The node leaves the container that held other.
+  if (value_ && value_->parent() != nullptr) {
+    details::InvalidateTreeHashes(value_->parent());
+    value_->set_parent(nullptr);
+  }
+}
+
+// Containers are unlinked onto an explicit stack before they are destroyed,
+// so that nested destructors never recurse. Nodes still shared with another
+// tree are only released.
+Value::~Value() {
+  if (!IsLastContainerOwner(value_)) {
+    return;
+  }
+
+  std::vector<std::shared_ptr<details::_Value>> pending;
+  pending.push_back(std::move(value_));
+
+  while (!pending.empty()) {
+    std::shared_ptr<details::_Value> node = std::move(pending.back());
+    pending.pop_back();
+
+    // The storage is walked directly: taking nodes apart is not a change
+    // and must not follow their parent links.
+    if (node->is_array()) {
+      for (auto& element : node->as_array().elements_) {
+        if (IsLastContainerOwner(element.value_)) {
+          pending.push_back(std::move(element.value_));
+        }
+      }
+    } else {
+      for (auto& element : node->as_object().elements_) {
+        if (IsLastContainerOwner(element.second.value_)) {
+          pending.push_back(std::move(element.second.value_));
+        }
+      }
+    }
+  }
+}
+
+bool Value::is_null() const { return value_->type() == Type::NULL_VALUE; }
+bool Value::is_string() const { return value_->type() == Type::STRING; }
+bool Value::is_number() const { return value_->type() == Type::NUMBER; }
+bool Value::is_boolean() const { return value_->type() == Type::BOOLEAN; }
+bool Value::is_array() const { return value_->type() == Type::ARRAY; }
+bool Value::is_object() const { return value_->type() == Type::OBJECT; }
 
 bool Value::has_field(const std::string& key) const { return value_->has_field(key); }
 bool Value::has_string_field(const std::string& key) const { return value_->has_field(key) && value_->as_object().at(key).is_string(); }
@@ -36,26 +204,111 @@ bool Value::has_array_field(const std::string& key) const { return value_->has_f
 bool Value::has_object_field(const std::string& key) const { return value_->has_field(key) && value_->as_object().at(key).is_object(); }
 
 std::string Value::as_string() const { return value_->as_string(); }
-int32_t Value::as_integer() const { return value_->as_number().to_int32(); }
-double Value::as_double() const { return value_->as_number().to_double(); }
+int32_t Value::as_integer() const {
+  const Number* number = get_if<Number>();
+  if (number == nullptr) {
+    throw Exception("not a number");
+  }
+
+  return number->to_int32();
+}
+
+double Value::as_double() const {
+  const Number* number = get_if<Number>();
+  if (number == nullptr) {
+    throw Exception("not a number");
+  }
+
+  return number->to_double();
+}
 const Number& Value::as_number() const { return value_->as_number(); }
 bool Value::as_boolean() const { return value_->as_boolean(); }
-Array& Value::as_array() { return value_->as_array(); }
+Array& Value::as_array() {
+  BeginMutation();
+  return value_->as_array();
+}
+
 const Array& Value::as_array() const { return value_->as_array(); }
-Object& Value::as_object() { return value_->as_object(); }
+Object& Value::as_object() {
+  BeginMutation();
+  return value_->as_object();
+}
+
 const Object& Value::as_object() const { return value_->as_object(); }
 
 Value& Value::operator=(const Value& other) {
-  if (this != &other) {
-    value_ = std::unique_ptr<details::_Value>(other.value_->Copy());
+  if (this == &other) {
+    return *this;
   }
 
+  // Containers are created empty on entry and filled child by child.
+  // containers holds the destination container and its next child slot.
+  // Frozen subtrees are immutable and simply shared with the copy.
+  Value copy;
+  std::vector<std::pair<Value*, size_t>> containers;
+
+  Walker walker(other);
+  while (walker.Next()) {
+    if (walker.is_leaving()) {
+      containers.pop_back();
+      continue;
+    }
+
+    Value* target = &copy;
+    if (!containers.empty()) {
+      Value* parent = containers.back().first;
+      size_t slot = containers.back().second++;
+
+      target = parent->is_array() ? &parent->as_array().at(slot) : &(parent->as_object().begin() + slot)->second;
+    }
+
+    const Value& source = walker.value();
+    if (source.value_->frozen()) {
+      target->value_ = source.value_;
+
+      if (walker.is_container()) {
+        containers.push_back(std::pair<Value*, size_t>(target, 0));
+        walker.SkipChildren();
+      }
+    } else if (source.is_array()) {
+      target->value_ = std::make_shared<details::_Array>(source.as_array().size());
+      containers.push_back(std::pair<Value*, size_t>(target, 0));
+    } else if (source.is_object()) {
+      Object::StorageType fields;
+      fields.reserve(source.as_object().size());
+
+      for (auto& field : source.as_object()) {
+        fields.push_back(std::pair<std::string, Value>(field.first, Value()));
+      }
+
+      target->value_ = std::make_shared<details::_Object>(std::move(fields));
+      containers.push_back(std::pair<Value*, size_t>(target, 0));
+    } else {
+      target->value_ = source.value_->Copy();
+    }
+  }
+
+  Replace(std::move(copy.value_));
+
   return *this;
 }
 
 Value& Value::operator=(Value&& other) noexcept {
   if (this != &other) {
+    const details::_Value* parent = value_ ? value_->parent() : nullptr;
+    const details::_Value* other_parent = other.value_ ? other.value_->parent() : nullptr;
+
+    details::InvalidateTreeHashes(parent);
+    details::InvalidateTreeHashes(other_parent);
     value_.swap(other.value_);
+
+    if (value_ && !value_->frozen()) {
+      value_->set_parent(parent);
+    }
+
+    if (other.value_ && !other.value_->frozen()) {
+      other.value_->set_parent(other_parent);
+    }
   }
 
   return *this;
@@ -63,221 +316,502 @@ Value& Value::operator=(Value&& other) noexcept {
 
 Value& Value::operator[](size_t index) {
   if (this->is_null()) {
-    value_.reset(new details::_Array());
+    Replace(std::make_shared<details::_Array>());
   }
 
+  BeginMutation();
+
   return value_->Get(index);
 }
 
+void Value::BeginMutation() {
+  Unshare();
+  details::InvalidateTreeHashes(value_.get());
+}
+
+// Puts node in place of the current one. The container holding this Value
+// changes, and node takes over the link to it.
+void Value::Replace(std::shared_ptr<details::_Value> node) {
+  const details::_Value* parent = value_ ? value_->parent() : nullptr;
+
+  details::InvalidateTreeHashes(parent);
+  value_ = std::move(node);
+
+  if (!value_->frozen()) {
+    value_->set_parent(parent);
+  }
+}
+
+// Replaces a frozen container by a private shallow copy whose children are
+// still shared; they are unshared in turn when they are modified. A node
+// that nobody else refers to any more is simply thawed in place.
+void Value::Unshare() {
+  if (!value_->frozen()) {
+    return;
+  }
+
+  if (value_.use_count() == 1) {
+    value_->Unfreeze();
+    return;
+  }
+
+  if (value_->type() == Type::ARRAY) {
+    Array::StorageType elements;
+    elements.reserve(value_->as_array().size());
+
+    for (auto& element : static_cast<const details::_Array&>(*value_).array()) {
+      elements.push_back(Value(element.value_));
+    }
+
+    value_ = std::make_shared<details::_Array>(std::move(elements));
+  } else if (value_->type() == Type::OBJECT) {
+    Object::StorageType fields;
+    fields.reserve(value_->as_object().size());
+
+    for (auto& field : static_cast<const details::_Object&>(*value_).object()) {
+      fields.push_back(std::pair<std::string, Value>(field.first, Value(field.second.value_)));
+    }
+
+    value_ = std::make_shared<details::_Object>(std::move(fields));
+  }
+}
+
 Value& Value::operator[](const std::string& key) {
   if (this->is_null()) {
-    value_.reset(new details::_Object());
+    Replace(std::make_shared<details::_Object>());
   }
 
+  BeginMutation();
+
   return value_->Get(key);
 }
 
-void Value::Save(const std::string& file_path) {
-  std::ofstream output_file(file_path, std::ios::trunc);
-  if (!output_file.is_open()) {
-    return;
+const Value& Value::operator[](size_t index) const {
+  static const Value NULL_VALUE;
+
+  if (this->is_null() || index >= as_array().size()) {
+    return NULL_VALUE;
   }
 
-  value_->Format(output_file, 0);
+  return as_array().at(index);
+}
 
-  output_file.close();
+const Value& Value::operator[](const std::string& key) const {
+  static const Value NULL_VALUE;
+
+  if (this->is_null() || !has_field(key)) {
+    return NULL_VALUE;
+  }
+
+  return as_object().at(key);
 }
 
-Value Value::Load(const std::string& file_path) {
-  static const std::regex REGEX_SEARCH("(<.+>)");
-  static const std::regex REGEX_PARENT_NEW("<([^/#\\s]+)>");
-  static const std::regex REGEX_PARENT_END("<(/[^#\\s]+)>");
-  static const std::regex REGEX_ARRAY_NEW("<#Array>");
-  static const std::regex REGEX_ARRAY_END("<Array#>");
-  static const std::regex REGEX_OBJECT_NEW("<#Object>");
-  static const std::regex REGEX_OBJECT_END("<Object#>");
-  static const std::regex REGEX_DATA("<key=\\\"([^\\\"]+)\\\"\\s+type=\\\"([^\\\"]+)\\\"\\s+value=\\\"([^\\\"]+)\\\">");
-  static const std::regex REGEX_DATA_NO_KEY("<type=\\\"([^\\\"]+)\\\"\\s+value=\\\"([^\\\"]+)\\\">");
+DedupStats Value::Dedup() {
+  // Hash-consing in post-order, so that children are added before their
+  // containers.
+  DedupTable table;
 
-  std::ifstream intput_file(file_path);
-  if (!intput_file.is_open()) {
-    return null();
+  Walker walker(*this);
+  while (walker.Next()) {
+    if (!walker.is_container() || walker.is_leaving()) {
+      table.Add(const_cast<Value&>(walker.value()));
+    }
+  }
+
+  return table.stats();
+}
+
+bool Value::operator==(const Value& other) const {
+  if (value_ == other.value_) {
+    return true;
   }
 
-  Value new_value = null();
+  if (Hash() != other.Hash()) {
+    return false;
+  }
 
-  std::vector<std::pair<std::string, Value*>> parents;
+  // Equal hashes: confirm, skipping subtrees that are shared or whose cached
+  // hashes already differ.
+  std::vector<std::pair<const Value*, const Value*>> pending;
+  pending.push_back(std::pair<const Value*, const Value*>(this, &other));
 
-  std::string line;
-  while (!intput_file.eof()) {
-    std::getline(intput_file, line);
+  while (!pending.empty()) {
+    const details::_Value& lhs = *pending.back().first->value_;
+    const details::_Value& rhs = *pending.back().second->value_;
+    pending.pop_back();
 
-    std::smatch search_matches;
-    if (std::regex_search(line, search_matches, REGEX_SEARCH)) {
-      std::string data = search_matches[1];
-      std::smatch data_matches;
+    if (&lhs == &rhs) {
+      continue;
+    }
 
-      if (std::regex_match(data, data_matches, REGEX_PARENT_NEW)) {
-        if (parents.empty()) {
-          Value* backup = &new_value[data_matches[1]];
-          parents.push_back(std::pair<std::string, Value*>(data_matches[1], backup));
-        } else {
-          Value* backup = &(*parents.back().second)[data_matches[1]];
-          parents.push_back(std::pair<std::string, Value*>(data_matches[1], backup));
-        }
+    size_t lhs_hash;
+    size_t rhs_hash;
+    if (lhs.GetTreeHash(lhs_hash) && rhs.GetTreeHash(rhs_hash) && lhs_hash != rhs_hash) {
+      return false;
+    }
 
-        continue;
+    if (lhs.type() == Type::OBJECT && rhs.type() == Type::OBJECT && !IsSameShape(lhs, rhs)) {
+      // Fields in another order or null on one side only: match them by
+      // key. Null fields count as absent.
+      const Object& lhs_object = static_cast<const details::_Object&>(lhs).object();
+      const Object& rhs_object = static_cast<const details::_Object&>(rhs).object();
+
+      std::unordered_map<std::string_view, const Value*> rhs_fields;
+      rhs_fields.reserve(rhs_object.size());
+      for (auto& field : rhs_object) {
+        if (!field.second.is_null()) {
+          rhs_fields.emplace(field.first, &field.second);
+        }
       }
 
-      if (std::regex_match(data, data_matches, REGEX_PARENT_END)) {
-        if (parents.empty()) {
-          throw Exception("invalid config format");
-        } else {
-          parents.pop_back();
+      size_t matched = 0;
+      for (auto& field : lhs_object) {
+        if (field.second.is_null()) {
+          continue;
         }
 
-        continue;
+        auto iter = rhs_fields.find(field.first);
+        if (iter == rhs_fields.end()) {
+          return false;
+        }
+
+        pending.push_back(std::pair<const Value*, const Value*>(&field.second, iter->second));
+        ++matched;
       }
 
-      if (std::regex_match(data, data_matches, REGEX_ARRAY_NEW)) {
-        if (!parents.back().second->is_array()) {
-          *parents.back().second = array();
-        }
+      if (matched != rhs_fields.size()) {
+        return false;
+      }
 
-        Array::size_type size = parents.back().second->as_array().size();
+      continue;
+    }
 
-        if (parents.empty()) {
-          new_value[size] = array();
-          Value* backup = &new_value[size];
-          parents.push_back(std::pair<std::string, Value*>(data_matches[1], backup));
-        } else {
-          (*parents.back().second)[size] = array();
-          Value* backup = &(*parents.back().second)[size];
-          parents.push_back(std::pair<std::string, Value*>(data_matches[1], backup));
-        }
+    if (!IsSameShape(lhs, rhs)) {
+      return false;
+    }
 
-        continue;
+    if (lhs.type() == Type::ARRAY) {
+      const Array& lhs_array = static_cast<const details::_Array&>(lhs).array();
+      const Array& rhs_array = static_cast<const details::_Array&>(rhs).array();
+
+      for (Array::size_type i = 0; i < lhs_array.size(); ++i) {
+        pending.push_back(std::pair<const Value*, const Value*>(&lhs_array.at(i), &rhs_array.at(i)));
       }
+    } else if (lhs.type() == Type::OBJECT) {
+      const Object& lhs_object = static_cast<const details::_Object&>(lhs).object();
+      const Object& rhs_object = static_cast<const details::_Object&>(rhs).object();
 
-      if (std::regex_match(data, data_matches, REGEX_ARRAY_END)) {
-        if (parents.empty()) {
-          throw Exception("invalid config format");
-        } else {
-          parents.pop_back();
-        }
+      for (auto lhs_iter = lhs_object.begin(), rhs_iter = rhs_object.begin(); lhs_iter != lhs_object.end(); ++lhs_iter, ++rhs_iter) {
+        pending.push_back(std::pair<const Value*, const Value*>(&lhs_iter->second, &rhs_iter->second));
+      }
+    }
+  }
 
-        continue;
+  return true;
+}
+
+bool Value::operator!=(const Value& other) const { return !(*this == other); }
+
+void Value::Accept(Visitor& visitor) const {
+  Walker walker(*this);
+
+  while (walker.Next()) {
+    if (walker.is_leaving()) {
+      visitor.Leave(walker);
+    } else {
+      if (!visitor.Enter(walker)) {
+        walker.SkipChildren();
       }
 
-      if (std::regex_match(data, data_matches, REGEX_OBJECT_NEW)) {
-        if (!parents.back().second->is_array()) {
-          *parents.back().second = array();
-        }
+      if (!walker.is_container()) {
+        visitor.Leave(walker);
+      }
+    }
+  }
+}
 
-        Array::size_type size = parents.back().second->as_array().size();
+size_t Value::Hash() const {
+  size_t cached;
+  if (value_->GetTreeHash(cached)) {
+    return cached;
+  }
 
-        if (parents.empty()) {
-          new_value[size] = object();
-          Value* backup = &new_value[size];
-          parents.push_back(std::pair<std::string, Value*>(data_matches[1], backup));
-        } else {
-          (*parents.back().second)[size] = object();
-          Value* backup = &(*parents.back().second)[size];
-          parents.push_back(std::pair<std::string, Value*>(data_matches[1], backup));
-        }
+  // One accumulator per open container; a finished child is folded into its
+  // parent, together with its key in an object. Containers whose hash is cached
+  // are not entered. Unfrozen nodes are linked to their container on the
+  // way, so that changing them retires the caches above.
+  std::vector<size_t> hashes;
+  std::vector<const details::_Value*> containers;
+  size_t result = 0;
+
+  Walker walker(*this);
+  while (walker.Next()) {
+    const details::_Value& node = *walker.value().value_;
+    size_t hash;
+
+    if (!walker.is_leaving() && !containers.empty() && !node.frozen() && node.parent() != containers.back()) {
+      node.set_parent(containers.back());
+    }
 
-        continue;
+    if (walker.is_container() && !walker.is_leaving()) {
+      if (node.GetTreeHash(hash)) {
+        walker.SkipChildren();
+      } else {
+        hash = node.Hash();
+      }
+
+      hashes.push_back(hash);
+      containers.push_back(&node);
+      continue;
+    } else if (walker.is_leaving()) {
+      if (!node.GetTreeHash(hash)) {
+        hash = hashes.back();
+        node.SetTreeHash(hash);
       }
 
-      if (std::regex_match(data, data_matches, REGEX_OBJECT_END)) {
-        if (parents.empty()) {
-          throw Exception("invalid config format");
+      hashes.pop_back();
+      containers.pop_back();
+    } else {
+      hash = node.Hash();
+    }
+
+    if (hashes.empty()) {
+      result = hash;
+    } else if (walker.in_array()) {
+      hashes.back() = details::HashCombine(hashes.back(), hash);
+    } else if (!node.is_null()) {
+      // Fields are summed, so that their order does not matter; null fields
+      // count as absent, as in operator== and Diff().
+      hashes.back() += details::HashCombine(std::hash<std::string>()(walker.key()), hash);
+    }
+  }
+
+  return result;
+}
+
+void Value::Format(std::ostream& out) const {
+  static const int INDENT_WIDTH = 2;
+  static const char SPACES[] = "                                                                ";
+
+  Walker walker(*this);
+  while (walker.Next()) {
+    const Value& value = walker.value();
+
+    if (walker.depth() == 0 && walker.is_container()) {
+      continue;
+    }
+
+    if (value.is_null()) {
+      continue;
+    }
+
+    for (size_t indent = (walker.depth() == 0 ? 0 : walker.depth() - 1) * INDENT_WIDTH; indent > 0;) {
+      size_t count = std::min(indent, sizeof(SPACES) - 1);
+      out.write(SPACES, count);
+      indent -= count;
+    }
+
+    if (walker.is_container()) {
+      if (walker.in_array()) {
+        if (walker.is_leaving()) {
+          out << (value.is_array() ? "<Array#>" : "<Object#>") << '\n';
         } else {
-          parents.pop_back();
+          out << (value.is_array() ? "<#Array>" : "<#Object>") << '\n';
         }
+      } else {
+        out << (walker.is_leaving() ? "</" : "<") << walker.key() << ">\n";
+      }
+    } else {
+      out << '<';
+      if (walker.depth() > 0 && !walker.in_array()) {
+        out << "key=\"" << walker.key() << "\" ";
+      }
 
-        continue;
+      value.value_->FormatData(out);
+      out << ">\n";
+    }
+  }
+}
+
+void Value::Save(const std::string& file_path) {
+  std::ofstream output_file(file_path, std::ios::trunc);
+  if (!output_file.is_open()) {
+    return;
+  }
+
+  Format(output_file);
+
+  output_file.close();
+}
+
+Value Value::Load(const std::string& file_path, DedupStats* dedup) {
+  std::ifstream input_file(file_path, std::ios::binary);
+  if (!input_file.is_open()) {
+    return null();
+  }
+
+  return Load(input_file, dedup);
+}
+
+Value Value::Load(std::istream& input, DedupStats* dedup) {
+  static const size_t CHUNK_SIZE = 64 * 1024;
+
+  ValueBuilder builder(dedup);
+  Parser parser(builder);
+  std::vector<char> buffer(CHUNK_SIZE);
+
+  while (input) {
+    input.read(buffer.data(), buffer.size());
+    parser.Feed(buffer.data(), static_cast<size_t>(input.gcount()));
+  }
+
+  parser.Finish();
+  return builder.Release();
+}
+
+LoadAllResult Value::LoadAll(const std::vector<std::string>& file_paths, const LoadOptions& options) {
+  // Number of files past the one a worker claims whose read-ahead it starts.
+  static const size_t READ_AHEAD = 4;
+
+  LoadAllResult result;
+  result.files.resize(file_paths.size());
+
+  size_t thread_count = options.max_threads != 0 ? options.max_threads : std::thread::hardware_concurrency();
+  thread_count = std::max<size_t>(1, std::min(thread_count, file_paths.size()));
+
+  std::vector<DedupStats> dedup(options.dedup ? file_paths.size() : 0);
+  std::vector<std::filesystem::file_type> file_types(file_paths.size());
+  std::vector<std::atomic<bool>> has_file_type(file_paths.size());
+  std::atomic<size_t> next(0);
+  std::atomic<size_t> prepared(0);
+
+  // Takes the files below end that nobody has prepared yet, looks up their
+  // type and lets the kernel start reading the regular ones, so that they
+  // are read while the current file is being parsed. Only regular files
+  // are opened: opening a FIFO would block, or hand the writer a reader
+  // that goes away immediately.
+  auto prepare = [&file_paths, &file_types, &has_file_type, &prepared](size_t end) {
+    size_t begin = prepared.load();
+    while (begin < end && !prepared.compare_exchange_weak(begin, end)) {
+    }
+
+    for (size_t i = begin; i < end; ++i) {
+      std::error_code error;
+      file_types[i] = std::filesystem::status(file_paths[i], error).type();
+
+#ifdef __linux__
+      if (file_types[i] == std::filesystem::file_type::regular) {
+        int fd = ::open(file_paths[i].c_str(), O_RDONLY);
+        if (fd >= 0) {
+          ::posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+          ::close(fd);
+        }
       }
+#endif
+
+      has_file_type[i].store(true, std::memory_order_release);
+    }
+  };
 
-      if (std::regex_match(data, data_matches, REGEX_DATA)) {
-        if (parents.empty()) {
-          if (data_matches[2].compare("String") == 0) {
-            new_value[data_matches[1]] = string(data_matches[3]);
-            Value* backup = &new_value[data_matches[1]];
-          } else if (data_matches[2].compare("Number") == 0) {
-            if (data_matches[3].str().find(".") != std::string::npos) {
-              new_value[data_matches[1]] = number(std::stoll(data_matches[3]));
-            } else {
-              new_value[data_matches[1]] = number(std::stod(data_matches[3]));
-            }
-
-            Value* backup = &new_value[data_matches[1]];
-          } else if (data_matches[2].compare("Boolean") == 0) {
-            new_value[data_matches[1]] = boolean(data_matches[3].compare("false"));
-            Value* backup = &new_value[data_matches[1]];
-          } else {
-            throw Exception("invalid config format");
-          }
+  auto work = [&file_paths, &options, &result, &dedup, &file_types, &has_file_type, &next, &prepare]() {
+    for (size_t i = next++; i < file_paths.size(); i = next++) {
+      LoadResult& file = result.files[i];
+      file.path = file_paths[i];
+
+      try {
+        prepare(std::min(i + 1 + READ_AHEAD, file_paths.size()));
+
+        // Another worker may still be preparing this file.
+        std::filesystem::file_type file_type;
+        if (has_file_type[i].load(std::memory_order_acquire)) {
+          file_type = file_types[i];
         } else {
-          if (data_matches[2].compare("String") == 0) {
-            (*parents.back().second)[data_matches[1]] = string(data_matches[3]);
-            Value* backup = &(*parents.back().second)[data_matches[1]];
-          } else if (data_matches[2].compare("Number") == 0) {
-            if (data_matches[3].str().find(".") != std::string::npos) {
-              (*parents.back().second)[data_matches[1]] = number(std::stoll(data_matches[3]));
-            } else {
-              (*parents.back().second)[data_matches[1]] = number(std::stod(data_matches[3]));
-            }
-
-            Value* backup = &(*parents.back().second)[data_matches[1]];
-          } else if (data_matches[2].compare("Boolean") == 0) {
-            (*parents.back().second)[data_matches[1]] = boolean(data_matches[3].compare("false"));
-            Value* backup = &(*parents.back().second)[data_matches[1]];
-          } else {
-            throw Exception("invalid config format");
-          }
+          std::error_code error;
+          file_type = std::filesystem::status(file.path, error).type();
         }
 
-        continue;
-      }
+        if (file_type == std::filesystem::file_type::directory) {
+          file.error = "cannot load a directory";
+          continue;
+        }
+
+        std::ifstream input_file(file.path, std::ios::binary);
+        if (!input_file.is_open()) {
+          file.error = "cannot open file";
+          continue;
+        }
+
+        input_file.seekg(0, std::ios::end);
+        std::streamoff size = input_file.tellg();
+
+        DedupStats* file_dedup = options.dedup ? &dedup[i] : nullptr;
 
-      if (std::regex_match(data, data_matches, REGEX_DATA_NO_KEY)) {
-        if (parents.empty()) {
-          throw Exception("invalid config format");
+        if (size < 0) {
+          // Not seekable (e.g. a pipe): parse it chunk by chunk instead.
+          input_file.clear();
+          file.value = Load(input_file, file_dedup);
         } else {
-          if (!parents.back().second->is_array()) {
-            throw Exception("invalid config format");
-          }
-
-          Array::size_type size = parents.back().second->as_array().size();
-
-          if (data_matches[1].compare("String") == 0) {
-            (*parents.back().second)[size] = string(data_matches[2]);
-            Value* backup = &(*parents.back().second)[size];
-          } else if (data_matches[1].compare("Number") == 0) {
-            if (data_matches[3].str().find(".") != std::string::npos) {
-              (*parents.back().second)[size] = number(std::stoll(data_matches[2]));
-            } else {
-              (*parents.back().second)[size] = number(std::stod(data_matches[2]));
-            }
-
-            Value* backup = &(*parents.back().second)[data_matches[1]];
-          } else if (data_matches[1].compare("Boolean") == 0) {
-            (*parents.back().second)[size] = boolean(data_matches[2].compare("false"));
-            Value* backup = &(*parents.back().second)[size];
-          } else {
-            throw Exception("invalid config format");
-          }
+          std::string buffer(static_cast<size_t>(size), '\0');
+          input_file.seekg(0, std::ios::beg);
+          input_file.read(&buffer[0], buffer.size());
+          input_file.close();
+
+          ValueBuilder builder(file_dedup);
+          Parser parser(builder);
+          parser.Feed(buffer.data(), buffer.size());
+          parser.Finish();
+          file.value = builder.Release();
         }
+      } catch (const std::exception& e) {
+        file.error = e.what();
+      }
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (size_t i = 1; i < thread_count; ++i) {
+    threads.emplace_back(work);
+  }
 
+  work();
+
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  for (auto& stats : dedup) {
+    result.dedup.shared_nodes += stats.shared_nodes;
+    result.dedup.bytes_saved += stats.bytes_saved;
+  }
+
+  if (options.merge_by_stem) {
+    result.merged = object();
+
+    for (auto& file : result.files) {
+      if (!file.ok()) {
+        continue;
+      }
+
+      std::string stem = std::filesystem::path(file.path).stem().string();
+      if (result.merged.has_field(stem)) {
+        file.error = "duplicate file stem";
+        file.value = null();
         continue;
       }
+
+      result.merged[stem] = std::move(file.value);
+      file.value = null();
     }
-  }
 
-  intput_file.close();
+    if (options.dedup) {
+      // Shares identical subtrees across files as well.
+      DedupStats stats = result.merged.Dedup();
+      result.dedup.shared_nodes += stats.shared_nodes;
+      result.dedup.bytes_saved += stats.bytes_saved;
+    }
+  }
 
-  return new_value;
+  return result;
 }
 
 Value Value::null() { return Value(); }
@@ -288,10 +822,110 @@ Value Value::number(uint32_t value) { return Value(value); }
 Value Value::number(uint64_t value) { return Value(value); }
 Value Value::number(double value) { return Value(value); }
 Value Value::boolean(bool value) { return Value(value); }
-Value Value::array() { return Value(std::move(std::make_unique<details::_Array>())); }
-Value Value::array(size_t size) { return Value(std::move(std::make_unique<details::_Array>(size))); }
-Value Value::array(std::vector<Value> elements) { return Value(std::move(std::make_unique<details::_Array>(elements))); }
-Value Value::object() { return Value(std::move(std::make_unique<details::_Object>())); }
-Value Value::object(std::vector<std::pair<std::string, Value>> elements) { return Value(std::move(std::make_unique<details::_Object>(elements))); }
+Value Value::array() { return Value(std::make_shared<details::_Array>()); }
+Value Value::array(size_t size) { return Value(std::make_shared<details::_Array>(size)); }
+Value Value::array(std::vector<Value> elements) { return Value(std::make_shared<details::_Array>(elements)); }
+Value Value::object() { return Value(std::make_shared<details::_Object>()); }
+Value Value::object(std::vector<std::pair<std::string, Value>> elements) { return Value(std::make_shared<details::_Object>(elements)); }
+
+Walker::Walker(const Value& root) : root_(&root), frames_(), started_(false), leaving_(false), skip_children_(false) {}
+
+bool Walker::Next() {
+  if (!started_) {
+    started_ = true;
+    frames_.push_back(Frame{root_, nullptr, 0, 0});
+    return true;
+  }
+
+  if (frames_.empty()) {
+    return false;
+  }
+
+  // A skip request only applies to the node it was made on.
+  bool skip_children = skip_children_;
+  skip_children_ = false;
+
+  if (!leaving_ && is_container()) {
+    if (skip_children) {
+      leaving_ = true;
+      return true;
+    }
+  } else {
+    frames_.pop_back();
+
+    if (frames_.empty()) {
+      return false;
+    }
+  }
+
+  leaving_ = !PushChild();
+  return true;
+}
+
+const std::string& Walker::key() const {
+  static const std::string EMPTY;
+
+  return frames_.back().key == nullptr ? EMPTY : *frames_.back().key;
+}
+
+std::string Walker::path() const {
+  std::string out;
+  AppendPath(out);
+
+  return out;
+}
+
+void Walker::AppendPath(std::string& out) const {
+  for (size_t i = 1; i < frames_.size(); ++i) {
+    if (frames_[i].key != nullptr) {
+      Path::Append(out, *frames_[i].key);
+    } else {
+      Path::Append(out, frames_[i].index);
+    }
+  }
+}
+
+bool Walker::PushChild() {
+  Frame& parent = frames_.back();
+  size_t next = parent.next;
+
+  if (parent.value->is_array()) {
+    const Array& array = parent.value->as_array();
+    if (next >= array.size()) {
+      return false;
+    }
+
+    parent.next++;
+    frames_.push_back(Frame{&array.at(next), nullptr, next, 0});
+  } else {
+    const Object& object = parent.value->as_object();
+    if (next >= object.size()) {
+      return false;
+    }
+
+    auto& field = *(object.begin() + next);
+    parent.next++;
+    frames_.push_back(Frame{&field.second, &field.first, 0, 0});
+  }
+
+  return true;
+}
+
+void Path::Append(std::string& path, std::string_view key) {
+  if (!path.empty()) {
+    path += '.';
+  }
+
+  path += key;
+}
+
+void Path::Append(std::string& path, Array::size_type index) { Append(path, std::to_string(index)); }
+
+std::string Path::Join(const std::string& path, std::string_view key) {
+  std::string out = path;
+  Append(out, key);
+
+  return out;
+}
 }  // namespace config
 }  // namespace akrbt
\ No newline at end of file
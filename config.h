@@ -1,11 +1,27 @@
 ﻿#pragma once
 
+// #include <algorithm>
+#include <algorithm>
+// #include <atomic>
+#include <atomic>
+// #include <cstdint>
+#include <cstdint>
 // #include <iostream>
 #include <iostream>
+// #include <limits>
+#include <limits>
 // #include <memory>
 #include <memory>
+// #include <sstream>
+#include <sstream>
 // #include <string>
 #include <string>
+// #include <string_view>
+#include <string_view>
+// #include <type_traits>
+#include <type_traits>
+// #include <unordered_map>
+#include <unordered_map>
 // #include <utility>
 #include <utility>
 // #include <vector>
@@ -24,15 +40,63 @@ class _Number;
 class _Boolean;
 class _Array;
 class _Object;
+
+// Retires the cached subtree hashes of node and of every container above it,
+// as far as Value::Hash() has linked them.
+void InvalidateTreeHashes(const _Value* node);
 }  // namespace details
 
 class Value;
 class Number;
 class Array;
 class Object;
+class Walker;
+class Visitor;
+struct LoadResult;
+struct LoadAllResult;
+
+struct LoadOptions {
+  // Upper bound on worker threads; 0 uses std::thread::hardware_concurrency().
+  size_t max_threads = 0;
+  // Also move every loaded file into LoadAllResult::merged under its file stem.
+  bool merge_by_stem = false;
+  // Share identical subtrees and strings while loading each file, and run
+  // Value::Dedup() on the merged tree.
+  bool dedup = false;
+};
+
+struct DedupStats {
+  size_t shared_nodes = 0;
+  // Approximate heap bytes of the nodes that were released.
+  size_t bytes_saved = 0;
+};
+
+// Hash-consing table behind Value::Dedup(). Add() replaces the node of a
+// Value by an identical one added before, or freezes it and keeps it. The
+// children of a container must have been added first: identical children
+// are then the same node, and containers are compared by child address.
+class DedupTable {
+ public:
+  void Add(Value& value);
+
+  const DedupStats& stats() const { return stats_; }
+
+ private:
+  std::unordered_multimap<size_t, std::shared_ptr<details::_Value>> nodes_;
+  DedupStats stats_;
+};
 
 class Value {
  public:
+  enum class Type {
+    NULL_VALUE,
+    STRING,
+    NUMBER,
+    BOOLEAN,
+    ARRAY,
+    OBJECT,
+  };
+
   Value();
   explicit Value(const std::string& value);
   explicit Value(int32_t value);
@@ -44,7 +108,9 @@ class Value {
 
   Value(const Value& other);
   Value(Value&& other) noexcept;
+  ~Value();
 
+  Type type() const;
   bool is_null() const;
   bool is_string() const;
   bool is_number() const;
@@ -69,14 +135,63 @@ class Value {
   Object& as_object();
   const Object& as_object() const;
 
+  // Non-allocating, non-virtual accessors. get_if<T>() accepts std::string,
+  // Number, bool, Array and Object and returns nullptr on a type mismatch;
+  // visit() calls f with one of those (or std::nullptr_t for null).
+  // Views and pointers stay valid until this Value is assigned to, mutated
+  // through a non-const accessor or destroyed.
+  std::string_view as_string_view() const;
+  template <typename T>
+  const T* get_if() const;
+  template <typename F>
+  decltype(auto) visit(F&& f) const;
+
   Value& operator=(const Value& other);
   Value& operator=(Value&& other) noexcept;
 
   Value& operator[](size_t index);
   Value& operator[](const std::string& key);
+  // Lookups that neither modify nor unshare the tree; a missing index or
+  // field reads as null.
+  const Value& operator[](size_t index) const;
+  const Value& operator[](const std::string& key) const;
+
+  // Shares identical subtrees and strings between all their occurrences.
+  // Shared nodes are frozen: modifying one through a non-const accessor
+  // first gives the modified Value its own copy, so readers and writers see
+  // no difference. Read through const accessors to keep nodes shared.
+  // Invalidates references into this tree.
+  DedupStats Dedup();
+  // True if both refer to the same node, e.g. after Dedup().
+  bool is_same(const Value& other) const { return value_ == other.value_; }
+
+  void Accept(Visitor& visitor) const;
+
+  // Structural (Merkle) hash. Every container caches the hash of its subtree
+  // and Hash() links every node to its parent, so a change through any
+  // accessor, or through a Value&, Array& or Object& taken beforehand,
+  // retires the caches on its way up to the root; other trees keep theirs. Modifying a node
+  // shared by Dedup() through a reference taken before Dedup() is not
+  // tracked. The cache is filled through atomics, so Hash() and operator==
+  // may run concurrently with other const accessors.
+  size_t Hash() const;
+
+  // Object fields are compared by key, in any order, and null fields count
+  // as absent, as in Diff(); array elements are compared by position. Shared
+  // nodes compare equal and differing cached hashes compare unequal without
+  // visiting the subtrees.
+  bool operator==(const Value& other) const;
+  bool operator!=(const Value& other) const;
 
   void Save(const std::string& file_path);
-  static Value Load(const std::string& file_path);
+  // If dedup is set, identical subtrees and strings are shared as soon as
+  // they are parsed, which also bounds the memory used while loading, and
+  // the savings are added to *dedup.
+  static Value Load(const std::string& file_path, DedupStats* dedup = nullptr);
+  static Value Load(std::istream& input, DedupStats* dedup = nullptr);
+  // Reads and parses the files concurrently. Results are in input order and
+  // a failing file only sets its own LoadResult::error.
+  static LoadAllResult LoadAll(const std::vector<std::string>& file_paths, const LoadOptions& options = LoadOptions());
 
   static Value null();
   static Value string(const std::string& value);
@@ -95,10 +210,16 @@ class Value {
  private:
   friend class details::_Array;
   friend class details::_Object;
+  friend class DedupTable;
 
-  explicit Value(std::unique_ptr<details::_Value> value);
+  explicit Value(std::shared_ptr<details::_Value> value);
 
-  std::unique_ptr<details::_Value> value_;
+  void BeginMutation();
+  void Unshare();
+  void Replace(std::shared_ptr<details::_Value> node);
+  void Format(std::ostream& out) const;
+
+  std::shared_ptr<details::_Value> value_;
 };
 
 class Number {
@@ -131,6 +252,27 @@ class Number {
       return static_cast<uint64_t>(int64_value_);
   }
 
+  bool operator==(const Number& other) const {
+    if (type_ != other.type_) {
+      return false;
+    }
+
+    switch (type_) {
+      case Type::SIGNED:
+        return int64_value_ == other.int64_value_;
+
+      case Type::UNSIGNED:
+        return uint64_value_ == other.uint64_value_;
+
+      case Type::DOUBLE:
+        return double_value_ == other.double_value_;
+    }
+
+    return false;
+  }
+
+  bool operator!=(const Number& other) const { return !(*this == other); }
+
   double to_double() const {
     switch (type_) {
       case Type::SIGNED:
@@ -148,6 +290,7 @@ class Number {
   }
 
  private:
+  friend class FrozenConfig;
   friend class details::_Number;
 
   enum class Type {
@@ -180,6 +323,14 @@ class Array {
   typedef StorageType::const_reverse_iterator const_reverse_iterator;
   typedef StorageType::size_type size_type;
 
+  Array(const Array& other) : elements_(other.elements_), owner_(nullptr) {}
+
+  Array& operator=(const Array& other) {
+    details::InvalidateTreeHashes(owner_);
+    elements_ = other.elements_;
+    return *this;
+  }
+
   iterator begin() { return elements_.begin(); }
   const_iterator begin() const { return elements_.cbegin(); }
   iterator end() { return elements_.end(); }
@@ -193,13 +344,17 @@ class Array {
   const_reverse_iterator crbegin() const { return elements_.crbegin(); }
   const_reverse_iterator crend() const { return elements_.crend(); }
 
-  iterator erase(iterator iter) { return elements_.erase(iter); }
+  iterator erase(iterator iter) {
+    details::InvalidateTreeHashes(owner_);
+    return elements_.erase(iter);
+  }
 
   void erase(size_type index) {
     if (index >= elements_.size()) {
       throw Exception("index out of bounds");
     }
 
+    details::InvalidateTreeHashes(owner_);
     elements_.erase(elements_.begin() + index);
   }
 
@@ -223,6 +378,7 @@ class Array {
 
   Value& operator[](size_type index) {
     if (index >= elements_.size()) {
+      details::InvalidateTreeHashes(owner_);
       elements_.resize(index + 1);
     }
 
@@ -230,13 +386,16 @@ class Array {
   }
 
  private:
+  friend class Value;
   friend class details::_Array;
 
-  Array() : elements_() {}
-  Array(size_type size) : elements_(size) {}
-  Array(StorageType elements) : elements_(std::move(elements)) {}
+  Array() : elements_(), owner_(nullptr) {}
+  Array(size_type size) : elements_(size), owner_(nullptr) {}
+  Array(StorageType elements) : elements_(std::move(elements)), owner_(nullptr) {}
 
   StorageType elements_;
+  // Node holding this array, whose cached hashes a change retires.
+  const details::_Value* owner_;
 };
 
 class Object {
@@ -248,20 +407,47 @@ class Object {
   typedef StorageType::const_reverse_iterator const_reverse_iterator;
   typedef StorageType::size_type size_type;
 
-  iterator begin() { return elements_.begin(); }
+  Object(const Object& other) : elements_(other.elements_), owner_(nullptr) {}
+
+  Object& operator=(const Object& other) {
+    details::InvalidateTreeHashes(owner_);
+    elements_ = other.elements_;
+    return *this;
+  }
+
+  // Keys can be modified through non-const iterators, so handing one out
+  // counts as a change.
+  iterator begin() {
+    details::InvalidateTreeHashes(owner_);
+    return elements_.begin();
+  }
   const_iterator begin() const { return elements_.cbegin(); }
-  iterator end() { return elements_.end(); }
+  iterator end() {
+    details::InvalidateTreeHashes(owner_);
+    return elements_.end();
+  }
   const_iterator end() const { return elements_.cend(); }
-  reverse_iterator rbegin() { return elements_.rbegin(); }
+  reverse_iterator rbegin() {
+    details::InvalidateTreeHashes(owner_);
+    return elements_.rbegin();
+  }
   const_reverse_iterator rbegin() const { return elements_.rbegin(); }
-  reverse_iterator rend() { return elements_.rend(); }
+  reverse_iterator rend() {
+    details::InvalidateTreeHashes(owner_);
+    return elements_.rend();
+  }
   const_reverse_iterator rend() const { return elements_.crend(); }
   const_iterator cbegin() const { return elements_.cbegin(); }
   const_iterator cend() const { return elements_.cend(); }
   const_reverse_iterator crbegin() const { return elements_.crbegin(); }
   const_reverse_iterator crend() const { return elements_.crend(); }
 
-  iterator erase(iterator iter) { return elements_.erase(iter); }
+  iterator erase(iterator iter) {
+    details::InvalidateTreeHashes(owner_);
+    return elements_.erase(iter);
+  }
+
+  size_type size() const { return elements_.size(); }
 
   void erase(const std::string& key) {
     iterator iter = FindByKey(key);
@@ -270,6 +456,7 @@ class Object {
       throw Exception("Key not found");
     }
 
+    details::InvalidateTreeHashes(owner_);
     elements_.erase(iter);
   }
 
@@ -297,6 +484,7 @@ class Object {
     iterator iter = FindInsertLocation(key);
 
     if (iter == elements_.end() || key != iter->first) {
+      details::InvalidateTreeHashes(owner_);
       return elements_.insert(iter, std::pair<std::string, Value>(key, Value()))->second;
     }
 
@@ -304,10 +492,11 @@ class Object {
   }
 
  private:
+  friend class Value;
   friend class details::_Object;
 
-  Object() : elements_() {}
-  Object(StorageType elements) : elements_(std::move(elements)) {}
+  Object() : elements_(), owner_(nullptr) {}
+  Object(StorageType elements) : elements_(std::move(elements)), owner_(nullptr) {}
 
   iterator FindInsertLocation(const std::string& key) {
     return std::find_if(elements_.begin(), elements_.end(), [&key](const std::pair<std::string, Value>& element) -> bool {
@@ -332,11 +521,144 @@ class Object {
   }
 
   StorageType elements_;
+  // Node holding this object, whose cached hashes a change retires.
+  const details::_Value* owner_;
+};
+
+// Depth-first traversal with an explicit stack, so nesting depth is not
+// limited by the call stack. Containers are visited twice, before their
+// children and again after them (is_leaving()); other nodes are visited once.
+class Walker {
+ public:
+  explicit Walker(const Value& root);
+
+  bool Next();
+  // Skips the children of the container just entered; has no effect on
+  // other nodes.
+  void SkipChildren() { skip_children_ = true; }
+
+  const Value& value() const { return *frames_.back().value; }
+  bool is_leaving() const { return leaving_; }
+  bool is_container() const { return value().type() == Value::Type::ARRAY || value().type() == Value::Type::OBJECT; }
+  size_t depth() const { return frames_.size() - 1; }
+
+  // Position of the current node in its parent; key() is empty for array
+  // elements and for the root.
+  bool in_array() const { return depth() > 0 && frames_.back().key == nullptr; }
+  const std::string& key() const;
+  Array::size_type index() const { return frames_.back().index; }
+
+  // Path of the current node, see Path.
+  std::string path() const;
+  void AppendPath(std::string& out) const;
+
+ private:
+  struct Frame {
+    const Value* value;
+    const std::string* key;
+    Array::size_type index;
+    size_t next;
+  };
+
+  bool PushChild();
+
+  const Value* root_;
+  std::vector<Frame> frames_;
+  bool started_;
+  bool leaving_;
+  bool skip_children_;
+};
+
+// A path names a node by the object keys and array indices leading to it
+// from the root, joined by '.' ("akrbt.pet.0"). The root has the empty path.
+// Keys that are empty or contain '.' cannot be told apart.
+class Path {
+ public:
+  // Appends one key or array index.
+  static void Append(std::string& path, std::string_view key);
+  static void Append(std::string& path, Array::size_type index);
+  static std::string Join(const std::string& path, std::string_view key);
+
+  // Reads the segment that starts at position and moves position past it.
+  // Returns false when there is none left; the empty path has none.
+  static constexpr bool Next(std::string_view path, size_t& position, std::string_view& segment) {
+    if (path.empty() || position > path.size()) {
+      return false;
+    }
+
+    size_t dot = path.find('.', position);
+    if (dot == std::string_view::npos) {
+      dot = path.size();
+    }
+
+    segment = path.substr(position, dot - position);
+    position = dot + 1;
+    return true;
+  }
+
+  // Reads an array index; false unless segment is a decimal number that
+  // fits in index.
+  static constexpr bool ParseIndex(std::string_view segment, Array::size_type& index) {
+    if (segment.empty()) {
+      return false;
+    }
+
+    index = 0;
+    for (char c : segment) {
+      if (c < '0' || c > '9') {
+        return false;
+      }
+
+      Array::size_type digit = static_cast<Array::size_type>(c - '0');
+      if (index > (static_cast<Array::size_type>(-1) - digit) / 10) {
+        return false;
+      }
+
+      index = index * 10 + digit;
+    }
+
+    return true;
+  }
+};
+
+// Every node gets exactly one Enter() and one Leave(), whatever Enter()
+// returns.
+class Visitor {
+ public:
+  // Pre-order. Returning false skips the children of a container.
+  virtual bool Enter(const Walker& walker) { return true; }
+  // Post-order; called right after Enter() for non-container nodes.
+  virtual void Leave(const Walker& walker) {}
+
+  virtual ~Visitor() {}
+};
+
+struct LoadResult {
+  std::string path;
+  Value value;
+  std::string error;
+
+  bool ok() const { return error.empty(); }
+};
+
+struct LoadAllResult {
+  std::vector<LoadResult> files;
+  // Object keyed by file stem if LoadOptions::merge_by_stem is set; the
+  // merged files are left null in files. Files whose stem was already taken
+  // are dropped and reported as failed.
+  Value merged;
+  DedupStats dedup;
 };
 
 namespace details {
+inline size_t HashCombine(size_t seed, size_t value) {
+  return seed ^ (value + static_cast<size_t>(0x9e3779b97f4a7c15ULL) + (seed << 6) + (seed >> 2));
+}
+
 class _Value {
  public:
+  Value::Type type() const { return type_; }
+
   virtual bool is_null() const { return false; }
   virtual bool is_string() const { return false; }
   virtual bool is_number() const { return false; }
@@ -356,49 +678,89 @@ class _Value {
   virtual Object& as_object() { throw Exception("not an object"); };
   virtual const Object& as_object() const { throw Exception("not an object"); };
 
-  virtual std::unique_ptr<_Value> Copy() = 0;
+  virtual std::shared_ptr<_Value> Copy() = 0;
 
   virtual Value& Get(size_t index) { throw Exception("not an array"); }
   virtual const Value& Get(size_t index) const { throw Exception("not an array"); }
   virtual Value& Get(const std::string& key) { throw Exception("not an object"); }
   virtual const Value& Get(const std::string& key) const { throw Exception("not an object"); }
 
-  virtual void Format(std::ostream& out, int indent) const {}
-  virtual void Format(std::ostream& out, int indent, const std::string& key) const {}
+  // Writes the `type="..." value="..."` part of a data tag.
+  virtual void FormatData(std::ostream& out) const {}
+  // Hash of the node itself, children excluded.
+  virtual size_t Hash() const { return 0; }
+  // Approximate heap bytes of the node itself, children excluded. The node
+  // shares one allocation with its shared_ptr control block.
+  virtual size_t Footprint() const { return CONTROL_BLOCK_SIZE + sizeof(*this); }
+
+  bool frozen() const { return frozen_; }
+  void Freeze() {
+    // A frozen node may have many parents.
+    parent_.store(nullptr, std::memory_order_relaxed);
+    frozen_ = true;
+  }
+  void Unfreeze() { frozen_ = false; }
+
+  // Container holding this unfrozen node, as last seen by Value::Hash().
+  const _Value* parent() const { return parent_.load(std::memory_order_relaxed); }
+  void set_parent(const _Value* parent) const { parent_.store(parent, std::memory_order_relaxed); }
+
+  // Cached hash of the subtree, if any. The hash is published by the release
+  // store of the flag.
+  bool GetTreeHash(size_t& hash) const {
+    if (!has_tree_hash_.load(std::memory_order_acquire)) {
+      return false;
+    }
+
+    hash = tree_hash_.load(std::memory_order_relaxed);
+    return true;
+  }
+  void SetTreeHash(size_t hash) const {
+    tree_hash_.store(hash, std::memory_order_relaxed);
+    has_tree_hash_.store(true, std::memory_order_release);
+  }
+  void InvalidateTreeHash() const { has_tree_hash_.store(false, std::memory_order_relaxed); }
 
   virtual ~_Value() {}
 
  protected:
-  static const int INDENT_WIDTH = 2;
+  // Reference counts and vtable pointer of the control block.
+  static const size_t CONTROL_BLOCK_SIZE = 2 * sizeof(void*);
+
+  explicit _Value(Value::Type type) : type_(type), frozen_(false), parent_(nullptr), tree_hash_(0), has_tree_hash_(false) {}
+  _Value(const _Value& other) : type_(other.type_), frozen_(false), parent_(nullptr), tree_hash_(0), has_tree_hash_(false) {}
 
-  _Value() {}
+ private:
+  const Value::Type type_;
+  bool frozen_;
+  mutable std::atomic<const _Value*> parent_;
+  mutable std::atomic<size_t> tree_hash_;
+  mutable std::atomic<bool> has_tree_hash_;
 };
 
 class _Null : public _Value {
  public:
+  _Null() : _Value(Value::Type::NULL_VALUE) {}
+
   virtual bool is_null() const { return true; }
 
-  virtual std::unique_ptr<_Value> Copy() { return std::make_unique<_Null>(); }
+  virtual std::shared_ptr<_Value> Copy() { return std::make_shared<_Null>(); }
 };
 
 class _String : public _Value {
  public:
-  _String(const std::string& value) : value_(value) {}
+  _String(const std::string& value) : _Value(Value::Type::STRING), value_(value) {}
+
+  const std::string& value() const { return value_; }
 
   virtual bool is_string() const { return true; }
   virtual std::string as_string() const { return value_; };
 
-  virtual std::unique_ptr<_Value> Copy() { return std::make_unique<_String>(*this); }
+  virtual std::shared_ptr<_Value> Copy() { return std::make_shared<_String>(*this); }
 
-  virtual void Format(std::ostream& out, int indent) const {
-    std::string indent_string(indent, ' ');
-    out << indent_string << "<type=\"String\" value=\"" << value_ << "\">" << std::endl;
-  }
-
-  virtual void Format(std::ostream& out, int indent, const std::string& key) const {
-    std::string indent_string(indent, ' ');
-    out << indent_string << "<key=\"" << key << "\" type=\"String\" value=\"" << value_ << "\">" << std::endl;
-  }
+  virtual void FormatData(std::ostream& out) const { out << "type=\"String\" value=\"" << value_ << "\""; }
+  virtual size_t Hash() const { return HashCombine(1, std::hash<std::string>()(value_)); }
+  virtual size_t Footprint() const { return CONTROL_BLOCK_SIZE + sizeof(*this) + (value_.capacity() > std::string().capacity() ? value_.capacity() + 1 : 0); }
 
  private:
   std::string value_;
@@ -406,77 +768,84 @@ class _String : public _Value {
 
 class _Number : public _Value {
  public:
-  _Number(int32_t value) : number_(value) {}
-  _Number(int64_t value) : number_(value) {}
-  _Number(uint32_t value) : number_(value) {}
-  _Number(uint64_t value) : number_(value) {}
-  _Number(double value) : number_(value) {}
+  _Number(int32_t value) : _Value(Value::Type::NUMBER), number_(value) {}
+  _Number(int64_t value) : _Value(Value::Type::NUMBER), number_(value) {}
+  _Number(uint32_t value) : _Value(Value::Type::NUMBER), number_(value) {}
+  _Number(uint64_t value) : _Value(Value::Type::NUMBER), number_(value) {}
+  _Number(double value) : _Value(Value::Type::NUMBER), number_(value) {}
+
+  const Number& number() const { return number_; }
 
   virtual bool is_number() const { return true; }
   virtual const Number& as_number() const { return number_; };
   virtual int as_integer() const { return number_.to_int32(); };
   virtual double as_double() const { return number_.to_double(); };
 
-  virtual std::unique_ptr<_Value> Copy() { return std::make_unique<_Number>(*this); }
-
-  virtual void Format(std::ostream& out, int indent) const {
-    std::string indent_string(indent, ' ');
+  virtual std::shared_ptr<_Value> Copy() { return std::make_shared<_Number>(*this); }
 
+  virtual void FormatData(std::ostream& out) const {
     switch (number_.type_) {
       case Number::Type::SIGNED:
-        out << indent_string << "<type=\"Number\" value=\"" << number_.int64_value_ << "\">" << std::endl;
+        out << "type=\"Number\" value=\"" << number_.int64_value_ << "\"";
         break;
 
       case Number::Type::UNSIGNED:
-        out << indent_string << "<type=\"Number\" value=\"" << number_.uint64_value_ << "\">" << std::endl;
+        out << "type=\"Number\" value=\"" << number_.uint64_value_ << "\"";
         break;
 
-      case Number::Type::DOUBLE:
-        out << indent_string << "<type=\"Number\" value=\"" << number_.double_value_ << "\">" << std::endl;
+      case Number::Type::DOUBLE: {
+        // Enough digits to read back the same double, and a '.' unless there
+        // is an exponent or it is inf or nan, so that it reads back as one.
+        std::ostringstream text;
+        text.precision(std::numeric_limits<double>::max_digits10);
+        text << number_.double_value_;
+
+        std::string digits = text.str();
+        if (digits.find_first_of(".en") == std::string::npos) {
+          digits += ".0";
+        }
+
+        out << "type=\"Number\" value=\"" << digits << "\"";
         break;
+      }
     }
   }
 
-  virtual void Format(std::ostream& out, int indent, const std::string& key) const {
-    std::string indent_string(indent, ' ');
-
+  virtual size_t Hash() const {
     switch (number_.type_) {
       case Number::Type::SIGNED:
-        out << indent_string << "<key=\"" << key << "\" type=\"Number\" value=\"" << number_.int64_value_ << "\">" << std::endl;
-        break;
+        return HashCombine(2, std::hash<int64_t>()(number_.int64_value_));
 
       case Number::Type::UNSIGNED:
-        out << indent_string << "<key=\"" << key << "\" type=\"Number\" value=\"" << number_.uint64_value_ << "\">" << std::endl;
-        break;
+        return HashCombine(3, std::hash<uint64_t>()(number_.uint64_value_));
 
       case Number::Type::DOUBLE:
-        out << indent_string << "<key=\"" << key << "\" type=\"Number\" value=\"" << number_.double_value_ << "\">" << std::endl;
-        break;
+        return HashCombine(4, std::hash<double>()(number_.double_value_));
     }
+
+    return 0;
   }
 
+  virtual size_t Footprint() const { return CONTROL_BLOCK_SIZE + sizeof(*this); }
+
  private:
   Number number_;
 };
 
 class _Boolean : public _Value {
  public:
-  _Boolean(bool value) : value_(value) {}
+  _Boolean(bool value) : _Value(Value::Type::BOOLEAN), value_(value) {}
+
+  const bool& value() const { return value_; }
 
   virtual bool is_boolean() const { return true; }
   virtual bool as_boolean() const { return value_; };
 
-  virtual std::unique_ptr<_Value> Copy() { return std::make_unique<_Boolean>(*this); }
-
-  virtual void Format(std::ostream& out, int indent) const {
-    std::string indent_string(indent, ' ');
-    out << indent_string << "<type=\"Boolean\" value=\"" << std::boolalpha << value_ << "\">" << std::endl;
-  }
+  virtual std::shared_ptr<_Value> Copy() { return std::make_shared<_Boolean>(*this); }
 
-  virtual void Format(std::ostream& out, int indent, const std::string& key) const {
-    std::string indent_string(indent, ' ');
-    out << indent_string << "<key=\"" << key << "\" type=\"Boolean\" value=\"" << std::boolalpha << value_ << "\">" << std::endl;
-  }
+  virtual void FormatData(std::ostream& out) const { out << "type=\"Boolean\" value=\"" << (value_ ? "true" : "false") << "\""; }
+  virtual size_t Hash() const { return HashCombine(5, value_ ? 1 : 0); }
+  virtual size_t Footprint() const { return CONTROL_BLOCK_SIZE + sizeof(*this); }
 
  private:
   bool value_;
@@ -484,74 +853,57 @@ class _Boolean : public _Value {
 
 class _Array : public _Value {
  public:
-  _Array() : array_() {}
-  _Array(Array::size_type size) : array_(size) {}
-  _Array(Array::StorageType elements) : array_(std::move(elements)) {}
+  _Array() : _Value(Value::Type::ARRAY), array_() { array_.owner_ = this; }
+  _Array(Array::size_type size) : _Value(Value::Type::ARRAY), array_(size) { array_.owner_ = this; }
+  _Array(Array::StorageType elements) : _Value(Value::Type::ARRAY), array_(std::move(elements)) { array_.owner_ = this; }
+  _Array(const _Array& other) : _Value(other), array_(other.array_) { array_.owner_ = this; }
+
+  const Array& array() const { return array_; }
 
   virtual bool is_array() const { return true; }
   virtual Array& as_array() { return array_; };
   virtual const Array& as_array() const { return array_; };
 
-  virtual std::unique_ptr<_Value> Copy() { return std::make_unique<_Array>(*this); }
+  virtual std::shared_ptr<_Value> Copy() { return std::make_shared<_Array>(*this); }
 
   virtual Value& Get(size_t index) { return array_[index]; }
 
-  virtual void Format(std::ostream& out, int indent) const {
-    std::string indent_string(indent, ' ');
-
-    for (auto& element : array_) {
-      if (element.is_null()) {
-        continue;
-      }
-
-      if (element.is_array()) {
-        out << indent_string << "<#Array>" << std::endl;
-        element.value_->Format(out, indent + INDENT_WIDTH);
-        out << indent_string << "<Array#>" << std::endl;
-      } else if (element.is_object()) {
-        out << indent_string << "<#Object>" << std::endl;
-        element.value_->Format(out, indent + INDENT_WIDTH);
-        out << indent_string << "<Object#>" << std::endl;
-      } else {
-        element.value_->Format(out, indent);
-      }
-    }
-  }
+  virtual size_t Hash() const { return 6; }
+  virtual size_t Footprint() const { return CONTROL_BLOCK_SIZE + sizeof(*this) + array_.size() * sizeof(Value); }
 
  private:
+  friend class Value;
+
   Array array_;
 };
 
 class _Object : public _Value {
  public:
-  _Object() : object_() {}
-  _Object(Object::StorageType fields) : object_(std::move(fields)) {}
+  _Object() : _Value(Value::Type::OBJECT), object_() { object_.owner_ = this; }
+  _Object(Object::StorageType fields) : _Value(Value::Type::OBJECT), object_(std::move(fields)) { object_.owner_ = this; }
+  _Object(const _Object& other) : _Value(other), object_(other.object_) { object_.owner_ = this; }
+
+  const Object& object() const { return object_; }
 
   virtual bool is_object() const { return true; }
   virtual bool has_field(const std::string& key) const { return object_.FindByKey(key) != object_.end(); }
   virtual Object& as_object() { return object_; };
   virtual const Object& as_object() const { return object_; };
 
-  virtual std::unique_ptr<_Value> Copy() { return std::make_unique<_Object>(*this); }
+  virtual std::shared_ptr<_Value> Copy() { return std::make_shared<_Object>(*this); }
 
   virtual Value& Get(const std::string& key) { return object_[key]; }
 
-  virtual void Format(std::ostream& out, int indent) const {
-    std::string indent_string(indent, ' ');
+  virtual size_t Hash() const { return 7; }
 
-    for (auto& element : object_) {
-      if (element.second.is_null()) {
-        continue;
-      }
+  virtual size_t Footprint() const {
+    size_t bytes = CONTROL_BLOCK_SIZE + sizeof(*this) + object_.size() * sizeof(std::pair<std::string, Value>);
 
-      if (element.second.is_array() || element.second.is_object()) {
-        out << indent_string << "<" << element.first << ">" << std::endl;
-        element.second.value_->Format(out, indent + INDENT_WIDTH);
-        out << indent_string << "</" << element.first << ">" << std::endl;
-      } else {
-        element.second.value_->Format(out, indent, element.first);
-      }
+    for (auto& field : object_) {
+      bytes += field.first.capacity() > std::string().capacity() ? field.first.capacity() + 1 : 0;
     }
+
+    return bytes;
   }
 
  private:
@@ -560,5 +912,55 @@ class _Object : public _Value {
   Object object_;
 };
 }  // namespace details
+
+inline Value::Type Value::type() const { return value_->type(); }
+
+inline std::string_view Value::as_string_view() const {
+  if (value_->type() != Type::STRING) {
+    throw Exception("not a string");
+  }
+
+  return static_cast<const details::_String*>(value_.get())->value();
+}
+
+template <typename T>
+const T* Value::get_if() const {
+  if constexpr (std::is_same<T, std::string>::value) {
+    return value_->type() == Type::STRING ? &static_cast<const details::_String*>(value_.get())->value() : nullptr;
+  } else if constexpr (std::is_same<T, Number>::value) {
+    return value_->type() == Type::NUMBER ? &static_cast<const details::_Number*>(value_.get())->number() : nullptr;
+  } else if constexpr (std::is_same<T, bool>::value) {
+    return value_->type() == Type::BOOLEAN ? &static_cast<const details::_Boolean*>(value_.get())->value() : nullptr;
+  } else if constexpr (std::is_same<T, Array>::value) {
+    return value_->type() == Type::ARRAY ? &static_cast<const details::_Array*>(value_.get())->array() : nullptr;
+  } else if constexpr (std::is_same<T, Object>::value) {
+    return value_->type() == Type::OBJECT ? &static_cast<const details::_Object*>(value_.get())->object() : nullptr;
+  } else {
+    static_assert(!std::is_same<T, T>::value, "unsupported type");
+  }
+}
+
+template <typename F>
+decltype(auto) Value::visit(F&& f) const {
+  switch (value_->type()) {
+    case Type::STRING:
+      return f(static_cast<const details::_String*>(value_.get())->value());
+
+    case Type::NUMBER:
+      return f(static_cast<const details::_Number*>(value_.get())->number());
+
+    case Type::BOOLEAN:
+      return f(static_cast<const details::_Boolean*>(value_.get())->value());
+
+    case Type::ARRAY:
+      return f(static_cast<const details::_Array*>(value_.get())->array());
+
+    case Type::OBJECT:
+      return f(static_cast<const details::_Object*>(value_.get())->object());
+
+    default:
+      return f(nullptr);
+  }
+}
 }  // namespace config
 }  // namespace akrbt
\ No newline at end of file
@@ -0,0 +1,115 @@
+﻿// Regression checks for Value::Hash(), operator== and Diff(). There is no
+// build system; from this directory:
+//
+//   g++ -std=c++17 -I.. config-hash-test.cpp ../config*.cpp && ./a.out
+
+// #include <cassert>
+#include <cassert>
+// #include <iostream>
+#include <iostream>
+
+// #include "config.h"
+#include "config.h"
+// #include "config-diff.h"
+#include "config-diff.h"
+
+using namespace akrbt::config;
+
+namespace {
+Value Sample() {
+  Value value;
+  value["server"]["port"] = Value::number(80);
+  value["server"]["host"] = Value::string("a");
+  value["other"]["x"] = Value::number(1);
+  value["list"][2] = Value::number(3);
+
+  return value;
+}
+
+// Caches filled before a change through a reference taken earlier must not
+// survive it.
+void TestChangeThroughEarlierReference() {
+  Value value = Sample();
+  Value& server = value["server"];
+  Value& port = server["port"];
+  Object& other = value["other"].as_object();
+  Array& list = value["list"].as_array();
+
+  Value before = value;
+  assert(before == value);
+
+  port = Value::number(81);
+  assert(before != value);
+  assert(Diff(before, value).size() == 1 && Diff(before, value)[0].path == "server.port");
+
+  before = value;
+  assert(before == value);
+  other.erase("x");
+  assert(before != value);
+
+  before = value;
+  assert(before == value);
+  list[5] = Value::number(1);
+  assert(before != value);
+
+  before = value;
+  assert(before == value);
+  value["server"].as_object().begin()->first = "renamed";
+  assert(before != value);
+}
+
+// Building, copying and reading other trees leaves the caches of a tree
+// alone, and a deduplicated copy still notices changes.
+void TestOtherTrees() {
+  Value value = Sample();
+  Value copy = value;
+  size_t hash = value.Hash();
+
+  Value other = Sample();
+  other["server"]["port"] = Value::number(1);
+  assert(value.Hash() == hash && value == copy && value != other);
+
+  Value shared = value;
+  shared.Dedup();
+  Value changed = shared;
+  assert(changed == shared);
+
+  changed["server"]["port"] = Value::number(82);
+  assert(changed != shared);
+  assert(Diff(shared, changed).size() == 1);
+}
+
+// Null fields count as absent and field order does not matter, in Hash(),
+// operator== and Diff() alike; array elements are positional.
+void TestNullAndOrder() {
+  Value with_null;
+  with_null["a"] = Value::number(1);
+  with_null["b"] = Value::null();
+
+  Value without_null;
+  without_null["a"] = Value::number(1);
+  assert(with_null == without_null && with_null.Hash() == without_null.Hash() && Diff(with_null, without_null).empty());
+
+  Value reordered;
+  reordered["b"] = Value::null();
+  reordered["x"] = Value::number(2);
+  reordered["a"] = Value::number(1);
+  with_null["x"] = Value::number(2);
+  assert(with_null == reordered && Diff(with_null, reordered).empty());
+
+  Value longer;
+  longer[1] = Value::null();
+  Value shorter;
+  shorter[0] = Value::null();
+  assert(longer != shorter && Diff(longer, shorter).size() == 1 && Diff(longer, shorter)[0].type == Change::Type::REMOVED);
+}
+}  // namespace
+
+int main() {
+  TestChangeThroughEarlierReference();
+  TestOtherTrees();
+  TestNullAndOrder();
+
+  std::cout << "ok" << std::endl;
+  return 0;
+}
\ No newline at end of file
@@ -0,0 +1,126 @@
+﻿// Regression checks for Parser and Value::Load(). There is no build system;
+// from this directory:
+//
+//   g++ -std=c++17 -I.. config-parser-test.cpp ../config*.cpp && ./a.out
+
+// #include <algorithm>
+#include <algorithm>
+// #include <cassert>
+#include <cassert>
+// #include <cstdio>
+#include <cstdio>
+// #include <iostream>
+#include <iostream>
+// #include <sstream>
+#include <sstream>
+// #include <string>
+#include <string>
+
+// #include "config.h"
+#include "config.h"
+// #include "config-parser.h"
+#include "config-parser.h"
+
+using namespace akrbt::config;
+
+namespace {
+const char SAMPLE[] = R"(<akrbt>
+  <key="nationality" type="String" value="korea">
+  <key="age" type="Number" value="25">
+  <key="height" type="Number" value="1.75">
+  <key="big" type="Number" value="18446744073709551615">
+  <key="student" type="Boolean" value="true">
+  <key="empty" type="String" value="">
+  <pet>
+    <type="String" value="choco">
+    <#Object>
+      <key="name" type="String" value="navi">
+    <Object#>
+  </pet>
+</akrbt>
+)";
+
+Value Parse(const std::string& text, size_t chunk_size) {
+  Parser parser;
+
+  for (size_t position = 0; position < text.size(); position += chunk_size) {
+    parser.Feed(text.data() + position, std::min(chunk_size, text.size() - position));
+  }
+
+  return parser.Finish();
+}
+
+std::string ErrorOf(const std::string& text) {
+  try {
+    Parse(text, text.size());
+  } catch (const Exception& e) {
+    return e.what();
+  }
+
+  return std::string();
+}
+
+// Chunks split anywhere, even inside a tag or a quoted value, give the same
+// tree as the whole input at once.
+void TestChunkSplits() {
+  std::string text = SAMPLE;
+  Value whole = Parse(text, text.size());
+
+  for (size_t chunk_size = 1; chunk_size < 16; ++chunk_size) {
+    assert(Parse(text, chunk_size) == whole);
+  }
+
+  std::istringstream input(text);
+  assert(Value::Load(input) == whole);
+}
+
+// Behaviour that changed with the push parser.
+void TestParserBehaviour() {
+  Value value = Parse(SAMPLE, sizeof(SAMPLE) - 1);
+  const Value& akrbt = value["akrbt"];
+
+  assert(akrbt["height"].get_if<Number>() != nullptr && akrbt["height"].as_double() == 1.75);
+  assert(akrbt["age"].as_integer() == 25);
+  assert(akrbt["big"].as_number().to_uint64() == 18446744073709551615ULL);
+  assert(akrbt["empty"].is_string() && akrbt["empty"].as_string().empty());
+  assert(akrbt["pet"][0].as_string() == "choco" && akrbt["pet"][1]["name"].as_string() == "navi");
+
+  Value root_array = Parse(R"(<type="Number" value="1"><type="Number" value="2">)", 7);
+  assert(root_array.is_array() && root_array.as_array().size() == 2);
+
+  Value reopened = Parse(R"(<a><key="x" type="Number" value="1"></a><a><key="y" type="Number" value="2"></a><b></b>)", 5);
+  assert(reopened["a"]["x"].as_integer() == 1 && reopened["a"]["y"].as_integer() == 2 && reopened["b"].is_null());
+
+  assert(ErrorOf("<a>\n<key=\"x\" type=\"Number\" value=\"1\">\n</b>").find("(line 3)") != std::string::npos);
+  assert(ErrorOf(R"(<key="x" type="Number" value="1x">)").find("invalid number") != std::string::npos);
+  assert(ErrorOf("<a>").find("unclosed tag") != std::string::npos);
+}
+
+// Doubles are saved with enough digits to read back the same double, and
+// always read back as doubles.
+void TestDoubleRoundTrip() {
+  Value value;
+  value["two"] = Value::number(2.0);
+  value["precise"] = Value::number(0.1234567891);
+  value["tenth"] = Value::number(0.1);
+  value["large"] = Value::number(1e300);
+  value["negative_zero"] = Value::number(-0.0);
+
+  value.Save("config-parser-test.config");
+  Value loaded = Value::Load("config-parser-test.config");
+  std::remove("config-parser-test.config");
+
+  for (auto& field : value.as_object()) {
+    assert(loaded[field.first].as_number() == field.second.as_number());
+  }
+}
+}  // namespace
+
+int main() {
+  TestChunkSplits();
+  TestParserBehaviour();
+  TestDoubleRoundTrip();
+
+  std::cout << "ok" << std::endl;
+  return 0;
+}
\ No newline at end of file
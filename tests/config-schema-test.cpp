@@ -0,0 +1,108 @@
+﻿// Regression checks for Schema and SchemaValidator. There is no build
+// system; from this directory:
+//
+//   g++ -std=c++17 -I.. config-schema-test.cpp ../config*.cpp && ./a.out
+
+// #include <cassert>
+#include <cassert>
+// #include <iostream>
+#include <iostream>
+// #include <sstream>
+#include <sstream>
+// #include <string>
+#include <string>
+// #include <vector>
+#include <vector>
+
+// #include "config.h"
+#include "config.h"
+// #include "config-schema.h"
+#include "config-schema.h"
+
+using namespace akrbt::config;
+
+namespace {
+CompiledSchema Sample() {
+  Schema service = Schema::object()
+                       .required("name", Schema::string())
+                       .optional("port", Schema::number().range(1, 65535))
+                       .optional("hosts", Schema::array(Schema::string()))
+                       .optional("limits", Schema::object().required("cpu", Schema::number()));
+
+  return Schema::object().required("svc", service).optional("list", Schema::array(Schema::object().required("k", Schema::number()))).Compile();
+}
+
+// Validates text while loading it and again as a loaded tree; both must
+// report the same paths.
+std::vector<std::string> Check(const CompiledSchema& schema, const std::string& text) {
+  std::istringstream input(text);
+  ValidationResult result = schema.Load(input);
+
+  std::istringstream tree_input(text);
+  std::vector<Violation> tree_violations = schema.Validate(Value::Load(tree_input));
+
+  std::vector<std::string> paths;
+  std::vector<std::string> tree_paths;
+  for (auto& violation : result.violations) {
+    paths.push_back(violation.path + ": " + violation.message);
+  }
+
+  for (auto& violation : tree_violations) {
+    tree_paths.push_back(violation.path + ": " + violation.message);
+  }
+
+  assert(result.ok() || result.value.is_null());
+  assert(paths.size() == tree_paths.size());
+  return paths;
+}
+
+void TestViolationPaths() {
+  CompiledSchema schema = Sample();
+
+  std::vector<std::string> paths = Check(schema, R"(<svc>
+  <key="port" type="Number" value="0">
+  <key="extra" type="Number" value="1">
+  <hosts>
+    <type="String" value="a">
+    <type="Number" value="2">
+  </hosts>
+  <limits><key="mem" type="Number" value="1"></limits>
+</svc>
+<list><#Object><key="k" type="Number" value="1"><Object#><#Object><key="k" type="String" value="x"><Object#></list>)");
+
+  assert(paths.size() == 7);
+  assert(paths[0] == "svc.port: out of range [1, 65535]");
+  assert(paths[1] == "svc.extra: unexpected key");
+  assert(paths[2] == "svc.hosts.1: expected String, got Number");
+  assert(paths[3] == "svc.limits.mem: unexpected key");
+  assert(paths[4] == "list.1.k: expected Number, got String");
+  assert(paths[5] == "svc.name: missing required key");
+  assert(paths[6] == "svc.limits.cpu: missing required key");
+
+  assert(Check(schema, "") == std::vector<std::string>{"svc: missing required key"});
+}
+
+// A named block opened again continues its fields, as the loaded tree does.
+void TestReopenedBlocks() {
+  CompiledSchema schema = Sample();
+
+  assert(Check(schema, R"(<svc><limits><key="x" type="Number" value="1"></limits></svc>
+<svc><key="name" type="String" value="a"><limits><key="cpu" type="Number" value="1"></limits></svc>)")
+             .size() == 1);
+  assert(Check(schema, R"(<svc><key="port" type="Number" value="1"></svc><svc><key="name" type="String" value="a"></svc>)").empty());
+  assert(Check(schema, R"(<svc><key="name" type="String" value="a"></svc><svc></svc>)") == std::vector<std::string>{"svc: missing required key"});
+
+  std::vector<std::string> paths = Check(schema, R"(<svc><key="name" type="String" value="a"></svc>
+<list><#Object><key="k" type="Number" value="1"><Object#></list>
+<list><#Object><Object#></list>)");
+  assert(paths == std::vector<std::string>{"list.1.k: missing required key"});
+}
+}  // namespace
+
+int main() {
+  TestViolationPaths();
+  TestReopenedBlocks();
+
+  std::cout << "ok" << std::endl;
+  return 0;
+}
\ No newline at end of file